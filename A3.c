@@ -1,22 +1,50 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/sysinfo.h>
 #include <unistd.h>
 #include <math.h>
 #include <signal.h>
 #include <sys/wait.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/ioctl.h>
+#include "sampler.h"
+#include "sched.h"
+#include "screen.h"
+#include "history.h"
+#include "output.h"
+#include "selfstats.h"
+#include "procs.h"
+#include "disk.h"
+#include "net.h"
+#include "freq.h"
+#include "agent.h"
+#include "psi.h"
+#include "alert.h"
+#include "adapt.h"
+#include "shm.h"
+#include "cgroup.h"
+#include "kstat.h"
+#include "topo.h"
+#include "canvas.h"
 
-//macro for memory y axis
-#define MEM_SCALE 12
 //macro for cpu y axis
 #define CPU_Y 10
 #define offset 8
-
-typedef struct {
-    unsigned long total;
-    unsigned long idle;
-} CPUStats;
+#define DISK_ROWS 16 //most devices the disk panel lists
+#define NET_Y 10 //rows of the network graph, its scale follows the data
+#define NET_ROWS 16 //most interfaces the network table lists
+#define PSI_Y 10 //rows of the pressure graph, its scale follows the data
+#define PSI_SERIES 6 //some and full avg10 of cpu, memory and io
+#define CGROUP_ROWS 16 //most cgroups the cgroup panel lists
+#define KSTAT_RAMP " .:-=+*#%@" //sparkline levels of the kernel panel, lowest first
+#define ANSI_RED 1 //series colors of the Braille graphs
+#define ANSI_GREEN 2
+#define ANSI_YELLOW 3
+#define ANSI_BLUE 4
+#define ANSI_MAGENTA 5
+#define ANSI_CYAN 6
 
 typedef struct {
     int samples; //variables to store the values of samples, tdelay and memory, cpu and cores flags
@@ -24,8 +52,99 @@ typedef struct {
     int memory;
     int cpu;
     int cores; //variables indicating if it should be shown. 1 (Default) is Yes 0 is No
+    int single; //1 samples every metric in this process instead of one child per metric
+    int frame_stats; //1 shows how many bytes each frame sent to the terminal
+    char *record; //file to record samples to, NULL when not recording
+    int record_max; //most MB the record file may take
+    char *replay; //file to replay samples from instead of sampling this machine
+    float replay_speed; //1 is real time, 0 is as fast as possible
+    int mem_stack; //1 stacks cache and swap on top of the used memory
+    int format; //headless output format, -1 draws the graphs instead
+    char *output; //file for the headless records, NULL is stdout
+    int flush_every; //headless records per write
+    int flush_ms; //or milliseconds between writes, whichever comes first
+    int self_stats; //1 measures the monitor's own latency, jitter and overhead
+    char *proc_root; //directory read in place of / for /proc and /sys, NULL is this machine
+    int procs; //rows of the process panel, 0 hides it
+    int procs_sort; //PROCS_BY_CPU or PROCS_BY_RSS
+    int procs_ms; //milliseconds between process scans, 0 scans every tick
+    int disks; //1 shows the disk panel
+    char *disk_filter; //fnmatch patterns of the devices to show, NULL is DISK_DEFAULT_FILTER
+    int net; //1 shows the network panel
+    int scroll; //1 runs until Ctrl-C with graphs as wide as the terminal that scroll left
+    int oversample; //samples per graph column, each column shows their min, max and average
+    int freq_ms; //milliseconds between reads of the per-core clocks, 0 reads them every tick
+    char *agent; //address samples are streamed to instead of drawn, NULL when not an agent
+    char *agent_name; //how the collector labels this agent, NULL is the host name
+    char *collector; //address agents are accepted on, NULL when not a collector
+    int psi; //1 shows the pressure stall panel
+    int psi_stall_ms; //a trigger fires after this much stall
+    int psi_window_ms; //within this window
+    char *alerts[ALERT_MAX]; //rules as given with --alert
+    int nalerts;
+    char *alert_exec; //command run on every alert transition, NULL for none
+    char *alert_fifo; //FIFO that gets a line per alert transition, NULL for none
+    int adaptive; //1 samples faster while CPU and memory move and slower while they are calm
+    long adapt_min_us; //shortest interval it samples at
+    long adapt_max_us; //longest one
+    char *shm; //shared memory segment the latest sample is published to, NULL for none
+    char *cgroup; //cgroup v2 path shown in the cgroup panel, NULL hides it
+    int cgroup_subtree; //1 shows the busiest cgroups below it too
+    int kernel; //1 shows the kernel activity panel
+    int braille; //1 draws the graphs with Braille dots, 2 columns and 4 levels per cell
 } info;
 
+typedef struct {
+    int x, y;
+} Cell;
+
+typedef struct {
+    Screen *scr; //every panel draws into this buffer, one flush per frame
+    int mrow;
+    int cpurow;
+    int coresrow; //rows where the memory, cpu and cores panels start
+    int cores; //number of cores in the grid
+    int bottom; //first free row below everything drawn
+    float totalram;
+    History *history; //where each tick is recorded, NULL when not recording
+    int procrow; //row of the process panel's header
+    ProcTable *procs; //scanned while sampling, NULL when the panel is hidden
+    int diskrow; //row of the disk panel's header
+    int disk_rows; //device rows below it
+    DiskTable *disks; //NULL when the panel is hidden
+    int netrow; //row where the network graph starts
+    int net_rows; //interface rows of the table under it
+    NetTable *net; //NULL when the panel is hidden
+    float *net_rx;
+    float *net_tx; //bytes/s of every plotted column, to replot them when the scale changes
+    int net_points;
+    int net_cols; //width of the graph
+    float net_scale; //bytes/s at the top of the graph
+    FreqTable *freq; //clock of each core, shown under its utilization. NULL without the cores grid
+    Fleet *fleet; //agents shown by a collector, NULL otherwise
+    int psirow; //row where the pressure graph starts
+    PsiTable *psi; //NULL when the panel is hidden
+    float *psi_vals; //PSI_SERIES values per plotted column, to replot them when the scale changes
+    int psi_points;
+    float psi_scale; //% at the top of the graph
+    int alertrow; //row of the first alert rule, 0 when there are none
+    int cgrouprow; //row of the cgroup panel's header
+    int cgroup_rows; //cgroup rows below it
+    CgroupTable *cgroups; //NULL when the panel is hidden
+    int kstatrow; //row of the kernel panel's header
+    KernelStats *kstat; //updated by the cpu collector, NULL when the panel is hidden
+    float *kstat_vals; //KSTAT_SERIES values per plotted column
+    int kstat_points;
+    Topology *topo; //groups the cores grid by NUMA node or socket, NULL for the flat grid
+    Cell *cell; //grid position of every cpu id with a topology, x 0 when it is not shown
+    Cell *block; //title position of every node's block
+    Canvas *mem_canvas; //Braille graphs with --braille, NULL draws them with characters
+    Canvas *cpu_canvas;
+    Canvas *net_canvas;
+    Canvas *psi_canvas;
+    int braille; //1 with --braille, the graphs take half as many cells as they have columns
+} layout;
+
 
 
 void clear_screen() { //Function to clear the screen
@@ -39,106 +158,82 @@ void reset_cursor(int rows) {
     fflush(stdout);  // Force the output to be written
 }
 
-// function to get the total ram in the system
-int get_ram() {
-    struct sysinfo info;
-    if (sysinfo(&info) == 0) {
-        int totalram = info.totalram / (1024 * 1024 * 1024);
-        return totalram;
-    } else {
-        perror("sysinfo error, unable to get memory utilization");
-        return 0;
-    }
-}
-
-void draw_axes(int rows, int cols, char *o_label, char *y_label,int row_start) {
+void draw_axes(Screen *scr, int rows, int cols, char *o_label, char *y_label,int row_start) {
     // Draw Y-axis (vertical line)
     for (int i = row_start; i <= rows + row_start; i++) {
-        printf("\033[%d;%dH|", i, offset);  // Move to (i, offset) and print '|'
+        screen_set(scr, i, offset, '|');  // Put '|' at (i, offset)
     }
 
     // Draw X-axis (horizontal line)
-    for (int j = offset; j <= cols+offset; j++) {
-        printf("\033[%d;%dH-", rows + row_start, j);  // Move to (ROWS, j) and print '-'
-    }
+    screen_fill(scr, rows + row_start, offset, cols + 1, '-');
 
     // Label the axes
-    printf("\033[%d;%dH%s", row_start+rows, 1, o_label);      // Origin
-    fflush(stdout);  // Force the output to be written
-    
-    printf("\033[%d;%dH%s", row_start, 1,y_label);        // Y-axis label
-    fflush(stdout);  // Force the output to be written
+    screen_put(scr, row_start+rows, 1, o_label);      // Origin
+    screen_put(scr, row_start, 1, y_label);        // Y-axis label
 }
 
-void plot_point(int x, int y, int rows, int row_start, char *label) {
+void plot_point(Screen *scr, int x, int y, int rows, int row_start, char *label) {
     int row = rows - y;    // Adjust row for terminal coordinates
     int col = offset + x;       // Offset by Y-axis column
 
-    // Move to the coordinate and print the point
-    printf("\033[%d;%dH%s", row_start + row, col,label);
-    fflush(stdout);  // Force the output to be written
+    screen_put(scr, row_start + row, col, label);
 }
 
-
-
-// function to get the y value for the memory utilization for the current sample
-int get_ram_y() {
-    struct sysinfo info;
-    if (sysinfo(&info) == 0) {
-        float totalram = (float)(info.totalram/ (1024 * 1024 * 1024));
-        float val = (float)(info.totalram - info.freeram) / (1024 * 1024 * 1024);
-        int y = (int)(val/totalram * MEM_SCALE); //Calculating the y value for memory utilization
-        
-        return y;
-    } else {
-        perror("sysinfo error, unable to get memory utilization");
-        exit(1);
-    }
+// Cells a graph of columns samples takes, with --braille every cell holds two of them
+int graph_cells(int columns, int braille){
+    return braille ? (columns + 1) / 2 : columns;
 }
-// function to get the cpu utilization for the current sample
-CPUStats get_cpu_utilization() {
-    FILE *fp = fopen("/proc/stat", "r");
-    CPUStats stats;
-    if (fp == NULL) {
-        perror("fopen error, unable to read /proc/stat");
-        exit(1);
-    }
-    char line[1024];
-    unsigned long long int user, nice, system, idle, iowait, irq, softirq, steal, guest; // Variables to store the CPU data
 
-    // Read the first line of /proc/stat
-    if(fgets(line, sizeof(line), fp) == NULL) {
-        perror("fgets error, unable to read /proc/stat");
-        exit(1);
+// Sends everything drawn since the last frame to the terminal in one write
+void end_frame(layout *l, info flags){
+    if(flags.frame_stats){
+        Screen *scr = l->scr;
+        screen_printf(scr, 2, 1, "Frame %lu: %zu bytes, %.0f bytes/frame on average        ", scr->frames, scr->last_bytes,
+                      scr->frames > 0 ? (double)scr->total_bytes / scr->frames : 0.0);
     }
-    fclose(fp); // Close the file
+    screen_flush(l->scr, l->bottom);
+}
 
-    // Parse the CPU data
-    sscanf(line, "cpu  %llu %llu %llu %llu %llu %llu %llu %llu %llu", 
-           &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal, &guest);
 
-    // Calculate total time and usage
-    
-    unsigned long long int idle_time = idle + iowait;
-    unsigned long long int non_idle_time = user + nice + system + irq + softirq + steal + guest;    
-    stats.total = idle_time + non_idle_time;
-    stats.idle = idle_time;
 
-    return stats;
+// Fills the memory fields of s from one read of /proc/meminfo
+void read_memory(Sample *s){
+    MemInfo m;
+    if(meminfo_read(&m) == -1){
+        exit(1);
+    }
+    s->mem_total = m.total / KB_PER_GB;
+    s->mem_used = (m.total - m.available) / KB_PER_GB; //Page cache can be reclaimed, so it is not counted as used
+    s->mem_available = m.available / KB_PER_GB;
+    s->mem_cached = m.cached / KB_PER_GB;
+    s->mem_buffers = m.buffers / KB_PER_GB;
+    s->mem_dirty = m.dirty / KB_PER_GB;
+    s->mem_shmem = m.shmem / KB_PER_GB;
+    s->swap_total = m.swap_total / KB_PER_GB;
+    s->swap_used = (m.swap_total - m.swap_free) / KB_PER_GB;
 }
 
-float get_cpu_percentage(CPUStats prev, CPUStats curr) {
-    unsigned long long int total_diff = curr.total - prev.total; //Calculating the difference between the total time
-    unsigned long long int idle_diff = curr.idle - prev.idle;   //Calculating the difference between the idle time
-    float utilization = 100.0 * (total_diff - idle_diff) / total_diff; //Calculating the CPU utilization
-    return utilization;
+// Copies the memory fields read by read_memory from src to dst
+void copy_memory(Sample *dst, const Sample *src){
+    dst->mem_used = src->mem_used;
+    dst->mem_total = src->mem_total;
+    dst->mem_available = src->mem_available;
+    dst->mem_cached = src->mem_cached;
+    dst->mem_buffers = src->mem_buffers;
+    dst->mem_dirty = src->mem_dirty;
+    dst->mem_shmem = src->mem_shmem;
+    dst->swap_total = src->swap_total;
+    dst->swap_used = src->swap_used;
 }
 
+// Each message is the head of a Sample with only the memory fields filled in
 void memory_child(int mem_pipe[], info flags){
     close(mem_pipe[0]); // Close read end of memory pipe
+    Sample mem;
+    memset(&mem, 0, SAMPLE_HEAD_SIZE);
     for(int i = 0; i < flags.samples; i++){
-        int y = get_ram_y(); //Function to get the y value for memory utilization
-        if(write(mem_pipe[1], &y, sizeof(y)) == -1){ //Writing the value of y to the pipe
+        read_memory(&mem); //Function to get the memory breakdown in GB
+        if(write(mem_pipe[1], &mem, SAMPLE_HEAD_SIZE) == -1){ //Writing the memory sample to the pipe
             perror("error writing to memory pipe");
             exit(1);
         }
@@ -146,25 +241,767 @@ void memory_child(int mem_pipe[], info flags){
     }
     close(mem_pipe[1]); // Close write end of memory pipe after writing all the values
 }
-void cpu_child(int cpu_pipe[], info flags){
+// Writes all of buf, the per-core message can be larger than PIPE_BUF
+int write_full(int fd, const void *buf, size_t len){
+    const char *p = buf;
+    while(len > 0){
+        ssize_t n = write(fd, p, len);
+        if(n <= 0){
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Reads exactly len bytes, returns 0 at end of file
+ssize_t read_full(int fd, void *buf, size_t len){
+    char *p = buf;
+    size_t got = 0;
+    while(got < len){
+        ssize_t n = read(fd, p + got, len - got);
+        if(n <= 0){
+            return n;
+        }
+        got += n;
+    }
+    return got;
+}
+
+// Each message is the aggregate utilization followed by one value per core
+void cpu_child(int cpu_pipe[], info flags, StatSample *prev){
     close(cpu_pipe[0]); // Close read end of CPU pipe
-    CPUStats prev_cpu = get_cpu_utilization(); // To keep track of the previous CPU utilization
-    
+    StatSample curr;
+    if(stat_init(&curr) == -1 || stat_read(prev) == -1){ // To keep track of the previous CPU utilization
+        exit(1);
+    }
+    int n = prev->ncores;
+    float *msg = malloc((n + 1) * sizeof(float));
+    if(msg == NULL){
+        perror("malloc error, unable to allocate CPU message");
+        exit(1);
+    }
+
     for(int i = 0; i < flags.samples; i++){
         usleep(flags.tdelay); //Function to sleep for tdelay microseconds before plotting the next point
-        CPUStats curr = get_cpu_utilization();
-        float utilization = get_cpu_percentage(prev_cpu, curr); //Function to get the CPU utilization for sample
-        if(write(cpu_pipe[1], &utilization, sizeof(utilization)) == -1){ //Writing the value of CPU utilization to the pipe
+        if(stat_read(&curr) == -1){
+            exit(1);
+        }
+        msg[0] = get_cpu_percentage(prev->cpu, curr.cpu); //Function to get the CPU utilization for sample
+        for(int c = 0; c < n; c++){
+            msg[c + 1] = get_cpu_percentage(prev->core[c], curr.core[c]);
+        }
+        if(write_full(cpu_pipe[1], msg, (n + 1) * sizeof(float)) == -1){ //Writing the CPU utilization to the pipe
             perror("error writing to CPU pipe");
             exit(1);
         }
-        
-        prev_cpu = curr;
+
+        StatSample tmp = *prev; //Swapping so the counter arrays are reused every sample
+        *prev = curr;
+        curr = tmp;
     }
+    free(msg);
     close(cpu_pipe[1]); // Close write end of CPU pipe after writing all the values
 }
 
-void plot_values(int mrow, int cpurow, info flags){
+void draw_core(Screen *scr, int x, int y){
+    //Drawing the core
+    screen_put(scr, y, x, "+--+");
+    screen_put(scr, y+1, x, "|");
+    screen_put(scr, y+1, x+3, "|");
+    screen_put(scr, y+2, x, "+--+");
+}
+// Position of core i in the grid, the grid is as close to a square as the core count allows
+void core_position(int i, int cores, int coresrow, int *x, int *y){
+    int height = sqrt(cores); //Calculating the height of the square
+    int width = cores/height; //Calculating the width of the square
+
+    *x = 1 + 8 * (i % width);
+    *y = coresrow + 5 * (i / width);
+}
+
+// Position of cpu in the grid, -1 when it has no cell, e.g. offline
+int core_cell(const layout *l, int cpu, int *x, int *y){
+    if(l->cell == NULL){
+        core_position(cpu, l->cores, l->coresrow, x, y);
+        return 0;
+    }
+    *x = l->cell[cpu].x;
+    *y = l->cell[cpu].y;
+    return *x > 0 ? 0 : -1;
+}
+
+// Lays the grid out one block per node, each as close to a square as its cpus allow and as wide
+// as a multiple of the SMT width so siblings share a row. Blocks sit side by side while they fit
+// in budget columns. Sets l->bottom and returns the width used
+int grid_layout(layout *l, int budget){
+    Topology *t = l->topo;
+    int row = l->coresrow + t->nnodes + 2; //Under the node table
+    int x0 = 1, band = 0, width = 0;
+    for(int i = 0; i < l->cores; i++){
+        l->cell[i].x = 0;
+    }
+    for(int g = 0; g < t->nnodes; g++){
+        TopoNode *n = &t->node[g];
+        l->block[g].x = 0;
+        if(n->n == 0){
+            continue; //Memory only, it is in the table
+        }
+        int w = n->n / (int)sqrt(n->n);
+        if(t->smt > 1 && w % t->smt != 0){
+            w += t->smt - w % t->smt;
+        }
+        w = w < n->n ? w : n->n;
+        int height = 1 + 5 * ((n->n + w - 1) / w); //Title, then the cells
+        if(x0 > 1 && x0 + 8 * w > budget){
+            row += band + 1;
+            x0 = 1;
+            band = 0;
+        }
+        l->block[g].x = x0;
+        l->block[g].y = row;
+        for(int j = 0; j < n->n; j++){
+            int cpu = t->order[n->first + j];
+            l->cell[cpu].x = x0 + 8 * (j % w);
+            l->cell[cpu].y = row + 1 + 5 * (j / w);
+        }
+        width = x0 + 8 * w > width ? x0 + 8 * w : width;
+        band = height > band ? height : band;
+        x0 += 8 * w + 2;
+    }
+    l->bottom = row + band;
+    return width;
+}
+
+// Name of group g of the topology, "node 1" or "socket 1"
+void node_name(const Topology *t, int g, char *buf, size_t len){
+    snprintf(buf, len, "%s %d", t->numa ? "node" : "socket", t->node[g].id);
+}
+
+void plot_cores(layout *l){
+    for (int i = 0; i < l->cores; i++) {
+        int x, y;
+        if(core_cell(l, i, &x, &y) == 0){
+            draw_core(l->scr, x, y); //Function to draw the core
+        }
+    }
+    if(l->topo != NULL){
+        for(int g = 0; g < l->topo->nnodes; g++){
+            char name[32];
+            node_name(l->topo, g, name, sizeof(name));
+            if(l->block[g].x > 0){
+                screen_put(l->scr, l->block[g].y, l->block[g].x, name);
+            }
+        }
+        screen_printf(l->scr, l->coresrow, 1, "%-9s %6s %5s %6s %-20s %8s %8s %6s %-20s", l->topo->numa ? "NODE" : "SOCKET",
+                      "SOCKET", "CPUS", "CPU%", "", "MEM GB", "OF GB", "MEM%", "");
+    }
+}
+
+// Fills the inside of the core at x, y to its utilization and prints the percentage under it
+void fill_core(Screen *scr, int x, int y, float utilization){
+    int level = (int)(utilization / 25 + 0.5); //0 to 4 half cells of fill
+    if(level < 0){
+        level = 0;
+    }
+    char fill[3];
+    fill[0] = level >= 2 ? '#' : level == 1 ? ':' : ' ';
+    fill[1] = level >= 4 ? '#' : level == 3 ? ':' : ' ';
+    fill[2] = '\0';
+    screen_put(scr, y+1, x+1, fill);
+    screen_printf(scr, y+3, x, "%3d%%", (int)(utilization + 0.5));
+}
+
+// A bar of width cells filled to pct
+void percent_bar(char *buf, int width, float pct){
+    int filled = (int)(pct / 100 * width + 0.5);
+    for(int i = 0; i < width; i++){
+        buf[i] = i < filled ? '#' : '.';
+    }
+    buf[width] = '\0';
+}
+
+// Refreshes the node table: CPU averaged over each node's cpus and memory from its own meminfo
+void plot_nodes(const Sample *sample, layout *l){
+    Topology *t = l->topo;
+    topo_cpu(t, sample->core, sample->ncores);
+    for(int g = 0; g < t->nnodes; g++){
+        TopoNode *n = &t->node[g];
+        char name[32], socket[16] = "-", cpu_bar[21], mem_bar[21];
+        node_name(t, g, name, sizeof(name));
+        if(n->package >= 0){
+            snprintf(socket, sizeof(socket), "%d", n->package);
+        }
+        percent_bar(cpu_bar, 20, n->cpu);
+        if(n->mem_total == 0){
+            screen_printf(l->scr, l->coresrow+1+g, 1, "%-9s %6s %5d %6.1f %-20s %8s %8s %6s", name, socket, n->n, n->cpu,
+                          cpu_bar, "-", "-", "-"); //Grouped by socket, memory is not split per socket
+            continue;
+        }
+        float total = n->mem_total / KB_PER_GB;
+        float pct = n->mem_used / total * 100;
+        percent_bar(mem_bar, 20, pct);
+        screen_printf(l->scr, l->coresrow+1+g, 1, "%-9s %6s %5d %6.1f %-20s %8.1f %8.1f %6.1f %-20s", name, socket, n->n,
+                      n->cpu, n->n > 0 ? cpu_bar : "", n->mem_used, total, pct, mem_bar);
+    }
+}
+
+// Prints the memory breakdown above its graph
+void memory_label(const Sample *s, layout *l){
+    screen_printf(l->scr, l->mrow-2, 9, " %.2f GB used, %.2f GB available, %.2f GB cache, %.2f GB dirty, %.2f GB shmem, swap %.2f / %.2f GB   ",
+                  s->mem_used, s->mem_available, s->mem_cached + s->mem_buffers, s->mem_dirty, s->mem_shmem,
+                  s->swap_used, s->swap_total);
+}
+
+// Plots one memory sample at column x and updates the breakdown above the graph.
+// With --mem-stack the column is filled instead: used '#', then cache and buffers '+', then swap '~'
+void plot_memory(int x, const Sample *s, layout *l, info flags){
+    Canvas *c = l->mem_canvas;
+    if(c != NULL){ //Used in green, then cache and buffers in cyan, then swap in magenta
+        canvas_clear_x(c, x-1);
+        int used = canvas_y(c, s->mem_used, l->totalram);
+        if(flags.mem_stack){
+            int cache = canvas_y(c, s->mem_used + s->mem_cached + s->mem_buffers, l->totalram);
+            int swap = canvas_y(c, s->mem_used + s->mem_cached + s->mem_buffers + s->swap_used, l->totalram);
+            canvas_vline(c, x-1, 0, used, ANSI_GREEN);
+            if(cache > used){
+                canvas_vline(c, x-1, used + 1, cache, ANSI_CYAN);
+            }
+            if(swap > cache){
+                canvas_vline(c, x-1, cache + 1, swap, ANSI_MAGENTA);
+            }
+        }
+        else{
+            canvas_line(c, 0, x-1, used, ANSI_GREEN);
+        }
+        canvas_show(c, x-1);
+    }
+    else if(flags.mem_stack){
+        float used = s->mem_used / l->totalram * MEM_SCALE;
+        float cache = used + (s->mem_cached + s->mem_buffers) / l->totalram * MEM_SCALE;
+        float swap = cache + s->swap_used / l->totalram * MEM_SCALE;
+        for(int y = 1; y <= MEM_SCALE && y <= swap + 0.5; y++){
+            plot_point(l->scr, x, y, MEM_SCALE, l->mrow, y <= used + 0.5 ? "#" : y <= cache + 0.5 ? "+" : "~");
+        }
+    }
+    else{
+        int mem_y = (int)(s->mem_used / l->totalram * MEM_SCALE + 0.5); //Calculating the y value for memory utilization
+        plot_point(l->scr, x, mem_y, MEM_SCALE, l->mrow, "#"); //Function to plot the point for memory utilization
+    }
+    memory_label(s, l);
+}
+
+// Prints the clock of the core at x, y under its percentage, blank when it is unknown
+void fill_freq(Screen *scr, int x, int y, float ghz){
+    if(ghz > 0){
+        screen_printf(scr, y+4, x, "%.2fG", ghz);
+    }
+    else{
+        screen_put(scr, y+4, x, "     ");
+    }
+}
+
+// Shows the live utilization and clock inside each core of the grid
+void fill_cores(const Sample *sample, layout *l){
+    int x, y;
+    int n = l->cores < sample->ncores ? l->cores : sample->ncores;
+    for(int c = 0; c < n; c++){
+        if(core_cell(l, c, &x, &y) == 0){
+            fill_core(l->scr, x, y, sample->core[c]);
+        }
+    }
+    if(l->freq != NULL && l->freq->source != FREQ_NONE){
+        n = l->cores < l->freq->n ? l->cores : l->freq->n;
+        for(int c = 0; c < n; c++){
+            if(core_cell(l, c, &x, &y) == 0){
+                fill_freq(l->scr, x, y, l->freq->ghz[c]);
+            }
+        }
+    }
+    if(l->topo != NULL){
+        plot_nodes(sample, l);
+    }
+}
+
+// Plots the CPU utilization of one sample at column x and refreshes the cores grid
+void plot_cpu(int x, const Sample *sample, layout *l, info flags){
+    if(flags.cpu){
+        float cpu_val = sample->cpu;
+        if(l->cpu_canvas != NULL){
+            canvas_clear_x(l->cpu_canvas, x-1);
+            canvas_line(l->cpu_canvas, 0, x-1, canvas_y(l->cpu_canvas, cpu_val, 100), ANSI_YELLOW);
+            canvas_show(l->cpu_canvas, x-1);
+        }
+        else{
+            plot_point(l->scr, x, cpu_val/10, CPU_Y, l->cpurow, ":"); //Function to plot the point for CPU utilization
+        }
+        screen_printf(l->scr, l->cpurow-2, 9, " %.2f %%         ", cpu_val); //Printing the CPU utilization above its graph
+    }
+    if(flags.cores){
+        fill_cores(sample, l);
+    }
+}
+
+// Redraws the process panel from the last scan, unused rows are blanked
+void plot_procs(layout *l){
+    ProcTable *t = l->procs;
+    screen_printf(l->scr, l->procrow-2, 1, " Processes: %lu, top %d by %s        ", t->nprocs, t->top_n,
+                  t->sort == PROCS_BY_RSS ? "RSS" : "CPU");
+    for(int i = 0; i < t->top_n; i++){
+        if(i < t->ntop){
+            ProcEntry *e = t->top[i];
+            screen_printf(l->scr, l->procrow+1+i, 1, "%7d  %-16s %7.1f %10.1f", e->pid, e->comm, e->cpu, e->rss / 1024.0);
+        }
+        else{
+            screen_fill(l->scr, l->procrow+1+i, 1, 45, ' ');
+        }
+    }
+}
+
+// Redraws the disk panel with the rates of the last two reads of /proc/diskstats
+void plot_disks(layout *l){
+    DiskTable *t = l->disks;
+    int row = 0;
+    for(int i = 0; i < t->ndev && row < l->disk_rows; i++){
+        DiskDev *d = &t->dev[i];
+        if(!d->shown){
+            continue;
+        }
+        screen_printf(l->scr, l->diskrow+1+row, 1, "%-12s %10.2f %10.2f %8.0f %8.2f %7.2f %6.1f", d->name,
+                      d->read_bps / 1048576, d->write_bps / 1048576, d->iops, d->await_ms, d->queue, d->util);
+        row++;
+    }
+    for(; row < l->disk_rows; row++){ //Devices that went away
+        screen_fill(l->scr, l->diskrow+1+row, 1, 70, ' ');
+    }
+}
+
+// Smallest 1, 2 or 5 times a power of ten at or above v, starting at 1 kB/s
+float nice_scale(float v){
+    for(float p = 1000; ; p *= 10){
+        if(v <= p){
+            return p;
+        }
+        if(v <= 2 * p){
+            return 2 * p;
+        }
+        if(v <= 5 * p){
+            return 5 * p;
+        }
+    }
+}
+
+// Bytes/s in at most 7 characters, so it fits left of the Y axis
+void format_rate(char *buf, size_t len, float bps){
+    if(bps >= 1e9){
+        snprintf(buf, len, "%.3gGB/s", bps / 1e9);
+    }
+    else if(bps >= 1e6){
+        snprintf(buf, len, "%.3gMB/s", bps / 1e6);
+    }
+    else{
+        snprintf(buf, len, "%.3gkB/s", bps / 1e3);
+    }
+}
+
+// Events/s with a k or M suffix, at most 6 characters
+void format_count(char *buf, size_t len, float v){
+    if(v >= 1e6){
+        snprintf(buf, len, "%.3gM", v / 1e6);
+    }
+    else if(v >= 1e4){
+        snprintf(buf, len, "%.3gk", v / 1e3);
+    }
+    else{
+        snprintf(buf, len, "%.0f", v);
+    }
+}
+
+// Plots column x of the network graph: received '#', sent ':', both '*'
+void net_point(layout *l, int x){
+    Canvas *c = l->net_canvas;
+    if(c != NULL){ //Received in green, sent in magenta
+        canvas_clear_x(c, x-1);
+        canvas_line(c, 0, x-1, canvas_y(c, l->net_rx[x-1], l->net_scale), ANSI_GREEN);
+        canvas_line(c, 1, x-1, canvas_y(c, l->net_tx[x-1], l->net_scale), ANSI_MAGENTA);
+        canvas_show(c, x-1);
+        return;
+    }
+    int rx = (int)(l->net_rx[x-1] / l->net_scale * NET_Y + 0.5);
+    int tx = (int)(l->net_tx[x-1] / l->net_scale * NET_Y + 0.5);
+    if(rx == tx){
+        plot_point(l->scr, x, rx, NET_Y, l->netrow, "*");
+        return;
+    }
+    plot_point(l->scr, x, rx, NET_Y, l->netrow, "#");
+    plot_point(l->scr, x, tx, NET_Y, l->netrow, ":");
+}
+
+// Adds the totals of the last read at column x and refreshes the interface table. When the largest
+// value on the graph needs another scale, the graph is cleared and every column is plotted again
+void plot_net(int x, layout *l){
+    NetTable *t = l->net;
+    char rx[16], tx[16];
+    if(x > l->net_cols){ //Scrolling, move every column left by one and draw them all again
+        memmove(l->net_rx, l->net_rx + 1, (l->net_cols - 1) * sizeof(float));
+        memmove(l->net_tx, l->net_tx + 1, (l->net_cols - 1) * sizeof(float));
+        x = l->net_cols;
+        l->net_scale = 0;
+    }
+    l->net_rx[x-1] = t->rx_bps;
+    l->net_tx[x-1] = t->tx_bps;
+    if(x > l->net_points){
+        l->net_points = x;
+    }
+    float top = 0;
+    for(int i = 0; i < l->net_points; i++){
+        top = l->net_rx[i] > top ? l->net_rx[i] : top;
+        top = l->net_tx[i] > top ? l->net_tx[i] : top;
+    }
+    float scale = nice_scale(top);
+    if(scale != l->net_scale){
+        l->net_scale = scale;
+        int width = graph_cells(l->net_cols, l->net_canvas != NULL);
+        for(int r = 0; r < NET_Y; r++){
+            screen_fill(l->scr, l->netrow + r, offset + 1, width, ' ');
+        }
+        screen_fill(l->scr, l->netrow + NET_Y, offset, width + 1, '-');
+        if(l->net_canvas != NULL){
+            canvas_clear(l->net_canvas);
+        }
+        format_rate(rx, sizeof(rx), scale);
+        screen_printf(l->scr, l->netrow, 1, "%-7s", rx);
+        for(int i = 1; i <= l->net_points; i++){
+            net_point(l, i);
+        }
+    }
+    else{
+        net_point(l, x);
+    }
+    format_rate(rx, sizeof(rx), t->rx_bps);
+    format_rate(tx, sizeof(tx), t->tx_bps);
+    screen_printf(l->scr, l->netrow-2, 12, " received %-9s sent %-9s %s  ", rx, tx,
+                  l->net_canvas != NULL ? "(green received, magenta sent)" : "(# received, : sent)");
+
+    int row = l->netrow + NET_Y + 3;
+    for(int i = 0; i < l->net_rows; i++){
+        if(i < t->n){
+            NetIface *f = &t->iface[i];
+            screen_printf(l->scr, row + i, 1, "%-12s %10.3f %10.3f %10.0f %10.0f %8.0f %8.0f", f->name, f->rx_bps / 1e6,
+                          f->tx_bps / 1e6, f->rx_pps, f->tx_pps, f->rx_dps, f->tx_dps);
+        }
+        else{
+            screen_fill(l->scr, row + i, 1, 76, ' '); //Interfaces that went away
+        }
+    }
+}
+
+// Blanks the inside of a graph drawn by draw_axes and restores its X axis
+void clear_graph(Screen *scr, int rows, int cols, int row_start){
+    for(int r = row_start; r < row_start + rows; r++){
+        screen_fill(scr, r, offset + 1, cols, ' ');
+    }
+    screen_fill(scr, row_start + rows, offset + 1, cols, '-');
+}
+
+// Redraws the cgroup panel, busiest first. CPU is a % of each cgroup's own cpu.max quota,
+// or of the whole machine when it has none
+void plot_cgroups(layout *l){
+    CgroupTable *t = l->cgroups;
+    for(int i = 0; i < l->cgroup_rows; i++){
+        if(i >= t->ntop){
+            screen_fill(l->scr, l->cgrouprow+1+i, 1, 104, ' '); //Cgroups that went away
+            continue;
+        }
+        Cgroup *c = t->top[i];
+        size_t len = strlen(c->path);
+        const char *name = len > 36 ? c->path + len - 36 : c->path; //The end of a deep path says the most
+        char quota[16] = "host", limit[16] = "-", used[16] = "-";
+        if(c->quota > 0){
+            snprintf(quota, sizeof(quota), "%.2f", c->quota);
+        }
+        if(c->has_mem){
+            snprintf(used, sizeof(used), "%.1f", c->mem_current / 1048576.0);
+        }
+        if(c->mem_max > 0){
+            snprintf(limit, sizeof(limit), "%.1f", c->mem_max / 1048576.0);
+        }
+        screen_printf(l->scr, l->cgrouprow+1+i, 1, "%-36s %7.2f %6s %7.1f %8.1f %10s %10s %6.1f", name, c->cpu, quota,
+                      c->throttled, c->throttled_ms, used, limit, c->mem_max > 0 ? c->mem_current * 100.0 / c->mem_max : 0.0);
+    }
+    if(t->subtree){
+        screen_printf(l->scr, l->cgrouprow-2, 11, " under %s: %zu cgroups, %lu listed by the last walk (%llu walks)       ",
+                      t->top_cg->path, t->used, t->walked, t->walk);
+    }
+}
+
+// Smallest of 1, 2, 5, 10, 20, 50 and 100 % that v fits under
+float psi_scale(float v){
+    static const float steps[] = { 1, 2, 5, 10, 20, 50 };
+    for(int i = 0; i < (int)(sizeof(steps) / sizeof(steps[0])); i++){
+        if(v <= steps[i]){
+            return steps[i];
+        }
+    }
+    return 100;
+}
+
+// Plots column x of the pressure graph, full avg10 as C/M/I first so some avg10 as c/m/i wins
+// when they share a cell. Zero values stay off the graph so the axis stays readable
+void psi_point(layout *l, int x){
+    static const char *marks[PSI_SERIES] = { "C", "M", "I", "c", "m", "i" };
+    static const int colors[PSI_SERIES] = { ANSI_RED, ANSI_MAGENTA, ANSI_BLUE, ANSI_YELLOW, ANSI_GREEN, ANSI_CYAN };
+    Canvas *c = l->psi_canvas;
+    if(c != NULL){
+        canvas_clear_x(c, x-1);
+        for(int k = 0; k < PSI_SERIES; k++){
+            float v = l->psi_vals[(x-1) * PSI_SERIES + k];
+            if(v > 0){
+                canvas_line(c, k, x-1, canvas_y(c, v, l->psi_scale), colors[k]);
+            }
+        }
+        canvas_show(c, x-1);
+        return;
+    }
+    for(int k = 0; k < PSI_SERIES; k++){
+        float v = l->psi_vals[(x-1) * PSI_SERIES + k];
+        if(v > 0){
+            plot_point(l->scr, x, (int)(v / l->psi_scale * PSI_Y + 0.5), PSI_Y, l->psirow, (char *)marks[k]);
+        }
+    }
+}
+
+// Refreshes the table under the pressure graph
+void psi_table(layout *l){
+    int row = l->psirow + PSI_Y + 3;
+    long long now = now_ns();
+    for(int i = 0; i < PSI_RESOURCES; i++){
+        PsiResource *r = &l->psi->res[i];
+        if(r->file.fd == -1){
+            screen_printf(l->scr, row + i, 1, "%-8s not available", r->name);
+            continue;
+        }
+        char last[24] = "-";
+        if(r->events > 0){
+            snprintf(last, sizeof(last), "%.1fs ago", (now - r->event_ns) / 1e9);
+        }
+        screen_printf(l->scr, row + i, 1, "%-8s %7.2f %7.2f %7.2f %9.1f %7.2f %9.1f %8lu %-12s", r->name, r->some.avg10,
+                      r->some.avg60, r->some.avg300, r->some_ms, r->full.avg10, r->full_ms, r->events,
+                      r->trigger_fd != -1 ? last : "no trigger");
+    }
+}
+
+// Adds the pressure of the last read at column x, rescaling and replotting like plot_net
+void plot_psi(int x, layout *l){
+    if(x > l->net_cols){ //Scrolling, the graphs are all as wide
+        memmove(l->psi_vals, l->psi_vals + PSI_SERIES, (l->net_cols - 1) * PSI_SERIES * sizeof(float));
+        x = l->net_cols;
+        l->psi_scale = 0;
+    }
+    float *v = &l->psi_vals[(x-1) * PSI_SERIES];
+    for(int i = 0; i < PSI_RESOURCES; i++){
+        v[i] = l->psi->res[i].full.avg10;
+        v[PSI_RESOURCES + i] = l->psi->res[i].some.avg10;
+    }
+    if(x > l->psi_points){
+        l->psi_points = x;
+    }
+    float top = 0;
+    for(int i = 0; i < l->psi_points * PSI_SERIES; i++){
+        top = l->psi_vals[i] > top ? l->psi_vals[i] : top;
+    }
+    float scale = psi_scale(top);
+    if(scale != l->psi_scale){
+        l->psi_scale = scale;
+        clear_graph(l->scr, PSI_Y, graph_cells(l->net_cols, l->psi_canvas != NULL), l->psirow);
+        if(l->psi_canvas != NULL){
+            canvas_clear(l->psi_canvas);
+        }
+        screen_printf(l->scr, l->psirow, 1, "%3g%%   ", scale);
+        for(int i = 1; i <= l->psi_points; i++){
+            psi_point(l, i);
+        }
+    }
+    else{
+        psi_point(l, x);
+    }
+    psi_table(l);
+}
+
+// One row of the kernel panel: the rate of the last column, the peak on the graph and a
+// sparkline of every column scaled to that peak, so quiet and busy counters both show their shape.
+// With --braille the sparkline is in eighth blocks and shows as many of the latest columns as
+// the Braille graphs do
+void kstat_row(layout *l, int k){
+    static const char ramp[] = KSTAT_RAMP;
+    static const uint32_t blocks[] = { ' ', 0x2581, 0x2582, 0x2583, 0x2584, 0x2585, 0x2586, 0x2587, 0x2588 };
+    int levels = l->braille ? (int)(sizeof(blocks) / sizeof(blocks[0])) - 1 : (int)sizeof(ramp) - 2;
+    int width = graph_cells(l->net_cols, l->braille);
+    int first = l->kstat_points > width ? l->kstat_points - width : 0;
+    float peak = 0;
+    for(int x = first; x < l->kstat_points; x++){
+        float v = l->kstat_vals[x * KSTAT_SERIES + k];
+        peak = v > peak ? v : peak;
+    }
+    char now[16], top[16];
+    format_count(now, sizeof(now), l->kstat->rate[k]);
+    format_count(top, sizeof(top), peak);
+    int row = l->kstatrow + 1 + k;
+    int col = 1 + screen_printf(l->scr, row, 1, "%-10s %8s %8s |", kstat_names[k], now, top);
+    for(int i = 0; i < width; i++){
+        int x = first + i;
+        int level = x < l->kstat_points && peak > 0 ? (int)(l->kstat_vals[x * KSTAT_SERIES + k] / peak * levels + 0.5) : 0;
+        screen_set(l->scr, row, col + i, l->braille ? blocks[level] : (uint32_t)ramp[level]);
+    }
+    screen_set(l->scr, row, col + width, '|');
+}
+
+// Adds the rates since the previous column at column x, scrolling like plot_psi
+void plot_kstat(int x, layout *l){
+    if(x > l->net_cols){
+        memmove(l->kstat_vals, l->kstat_vals + KSTAT_SERIES, (l->net_cols - 1) * KSTAT_SERIES * sizeof(float));
+        x = l->net_cols;
+    }
+    kstat_rates(l->kstat);
+    memcpy(&l->kstat_vals[(x-1) * KSTAT_SERIES], l->kstat->rate, KSTAT_SERIES * sizeof(float));
+    if(x > l->kstat_points){
+        l->kstat_points = x;
+    }
+    for(int k = 0; k < KSTAT_SERIES; k++){
+        if(k >= KSTAT_FIRST_VM && !l->kstat->has_vmstat){
+            screen_printf(l->scr, l->kstatrow + 1 + k, 1, "%-10s not available", kstat_names[k]);
+            continue;
+        }
+        kstat_row(l, k);
+    }
+}
+
+// A kernel trigger fired, shown right away instead of at the next tick
+void psi_event(void *ctx, PsiResource *r){
+    layout *l = ctx;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    struct tm tm;
+    localtime_r(&ts.tv_sec, &tm);
+    screen_printf(l->scr, l->psirow-1, 1, " %02d:%02d:%02d.%03ld %s stall: some avg10 %.2f%%, full avg10 %.2f%%          ",
+                  tm.tm_hour, tm.tm_min, tm.tm_sec, ts.tv_nsec / 1000000, r->name, r->some.avg10, r->full.avg10);
+    psi_table(l);
+    screen_flush(l->scr, l->bottom);
+}
+
+// min, max and average of the samples one screen column covers
+typedef struct {
+    float min, max, sum;
+    int n;
+} Agg;
+
+// What one column of the memory and CPU graphs shows with --oversample or --scroll
+typedef struct {
+    Agg mem, cpu;
+} Column;
+
+void agg_add(Agg *a, float v){
+    if(a->n == 0 || v < a->min){
+        a->min = v;
+    }
+    if(a->n == 0 || v > a->max){
+        a->max = v;
+    }
+    a->sum += v;
+    a->n++;
+}
+
+float agg_avg(const Agg *a){
+    return a->n > 0 ? a->sum / a->n : 0;
+}
+
+// Plots a bar of '.' from ymin to ymax with label at yavg, so short spikes stay visible
+void plot_range(Screen *scr, int x, int ymin, int ymax, int yavg, int rows, int row_start, char *label){
+    for(int y = ymin; y <= ymax; y++){
+        if(y != yavg){
+            plot_point(scr, x, y, rows, row_start, ".");
+        }
+    }
+    plot_point(scr, x, yavg, rows, row_start, label);
+}
+
+// A Braille column of an aggregate: min to max in blue with the average as a line over it
+void canvas_range(Canvas *c, int x, const Agg *a, float top, int color){
+    canvas_clear_x(c, x-1);
+    canvas_vline(c, x-1, canvas_y(c, a->min, top), canvas_y(c, a->max, top), ANSI_BLUE);
+    canvas_line(c, 0, x-1, canvas_y(c, agg_avg(a), top), color);
+    canvas_show(c, x-1);
+}
+
+// Draws column x of the memory and CPU graphs from its aggregate
+void plot_column(int x, const Column *col, layout *l, info flags){
+    if(l->mem_canvas != NULL || l->cpu_canvas != NULL){
+        if(l->mem_canvas != NULL){
+            canvas_range(l->mem_canvas, x, &col->mem, l->totalram, ANSI_GREEN);
+        }
+        if(l->cpu_canvas != NULL){
+            canvas_range(l->cpu_canvas, x, &col->cpu, 100, ANSI_YELLOW);
+        }
+        return;
+    }
+    if(flags.memory){
+        float k = MEM_SCALE / l->totalram;
+        plot_range(l->scr, x, (int)(col->mem.min * k + 0.5), (int)(col->mem.max * k + 0.5),
+                   (int)(agg_avg(&col->mem) * k + 0.5), MEM_SCALE, l->mrow, "#");
+    }
+    if(flags.cpu){
+        plot_range(l->scr, x, (int)(col->cpu.min / 10), (int)(col->cpu.max / 10), (int)(agg_avg(&col->cpu) / 10),
+                   CPU_Y, l->cpurow, ":");
+    }
+}
+
+// Adds column number count to the graphs. Once they are full the ring of columns moves left
+// by one and every column is drawn again, the screen diff only sends the cells that changed
+void push_column(int count, const Column *col, Column *ring, layout *l, info flags){
+    int width = flags.samples;
+    if(count <= width){
+        ring[count - 1] = *col;
+        plot_column(count, col, l, flags);
+        return;
+    }
+    memmove(ring, ring + 1, (width - 1) * sizeof(Column));
+    ring[width - 1] = *col;
+    if(flags.memory){
+        clear_graph(l->scr, MEM_SCALE, graph_cells(width, flags.braille), l->mrow);
+        if(l->mem_canvas != NULL){
+            canvas_clear(l->mem_canvas);
+        }
+    }
+    if(flags.cpu){
+        clear_graph(l->scr, CPU_Y, graph_cells(width, flags.braille), l->cpurow);
+        if(l->cpu_canvas != NULL){
+            canvas_clear(l->cpu_canvas);
+        }
+    }
+    for(int x = 1; x <= width; x++){
+        plot_column(x, &ring[x - 1], l, flags);
+    }
+}
+
+// Width of the terminal, 80 when it is not one
+int terminal_cols(){
+    struct winsize ws;
+    if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_col == 0){
+        return 80;
+    }
+    return ws.ws_col;
+}
+
+// Everything that happens once a tick's sample is complete
+void finish_tick(Sample *sample, layout *l, info flags){
+    if(l->history != NULL){
+        history_append(l->history, sample); //Recording the sample
+    }
+    end_frame(l, flags);
+}
+
+void plot_values(layout *l, info flags){
     int mem_pipe[2], cpu_pipe[2]; 
     int a = pipe(mem_pipe);
     int b = pipe(cpu_pipe); //Creating pipes for memory and cpu utilization
@@ -180,131 +1017,689 @@ void plot_values(int mrow, int cpurow, info flags){
             perror("error creating child process");
             exit(1);
         }
-        if(m_pid == 0){
-            //reset handler for ctrl c using signal to ignore
-            signal(SIGINT, SIG_IGN);
-            memory_child(mem_pipe, flags); //Function to get the memory utilization values scaled to y axis
-            exit(0); //Exiting the child process
+        if(m_pid == 0){
+            //reset handler for ctrl c using signal to ignore
+            signal(SIGINT, SIG_IGN);
+            memory_child(mem_pipe, flags); //Function to get the memory utilization values
+            exit(0); //Exiting the child process
+        }
+    }
+    else{
+        close(mem_pipe[0]); // Close read end of memory pipe
+    }
+
+    StatSample stats;
+    if(stat_init(&stats) == -1){
+        exit(1);
+    }
+    int sample_cpu = flags.cpu || flags.cores; //The CPU child also feeds the live cores grid
+
+    if(sample_cpu){
+        pid_t c_pid = fork(); //Creating a child process to get the CPU utilization values
+        if(c_pid == -1){
+            perror("error creating child process");
+            exit(1);
+        }
+        if(c_pid == 0){
+            //reset handler for ctrl c using signal to ignore 
+            signal(SIGINT, SIG_IGN);
+            cpu_child(cpu_pipe, flags, &stats); //Function to get the CPU utilization values
+            exit(0); //Exiting the child process
+        }
+    }
+    else{
+        close(cpu_pipe[0]); // Close read end of CPU pipe
+    }
+
+    close(mem_pipe[1]); // Close write end of memory pipe
+    close(cpu_pipe[1]); // Close write end of CPU pipe
+
+    Sample sample;
+    memset(&sample, 0, sizeof(sample));
+    sample.mem_total = l->totalram;
+    sample.ncores = stats.ncores < MAX_CORES ? stats.ncores : MAX_CORES;
+
+    Sample mem; //Only the memory fields of the head are sent
+    size_t msg_size = (stats.ncores + 1) * sizeof(float);
+    float *cpu_msg = malloc(msg_size); //Aggregate utilization followed by one value per core
+    if(cpu_msg == NULL){
+        perror("malloc error, unable to allocate CPU message");
+        exit(1);
+    }
+    int mem_read = read_full(mem_pipe[0], &mem, SAMPLE_HEAD_SIZE);
+    int cpu_read = read_full(cpu_pipe[0], cpu_msg, msg_size); //Reading the values of memory and cpu utilization from the pipes
+    int mcount = 0;
+    int ccount = 0; // maintaining the count of the number of points plotted for memory and cpu utilization
+
+    while((flags.memory && mcount < flags.samples) || (sample_cpu &&  ccount < flags.samples)){
+        sample.ts_ns = wall_ns();
+        if(flags.memory && mem_read > 0 && mcount < flags.samples){
+            copy_memory(&sample, &mem);
+            plot_memory(mcount + 1, &sample, l, flags);
+            mcount++;
+        }
+        if(sample_cpu && cpu_read > 0 && ccount < flags.samples){
+            if(l->freq != NULL){
+                freq_read(l->freq); //A pread per core, cheap enough to do here rather than in a child
+            }
+            if(l->topo != NULL){
+                topo_read_memory(l->topo); //Likewise a pread per node
+            }
+            sample.cpu = cpu_msg[0];
+            memcpy(sample.core, cpu_msg + 1, sample.ncores * sizeof(float));
+            plot_cpu(ccount + 1, &sample, l, flags);
+            ccount++;
+        }
+        finish_tick(&sample, l, flags);
+        mem_read = read_full(mem_pipe[0], &mem, SAMPLE_HEAD_SIZE);
+        cpu_read = read_full(cpu_pipe[0], cpu_msg, msg_size); //Reading the values of memory and cpu utilization from the pipes
+    }
+    free(cpu_msg);
+    stat_free(&stats);
+    close(mem_pipe[0]); // Close read end of memory pipe
+    close(cpu_pipe[0]); // Close read end of CPU pipe
+    wait(NULL); //Waiting for the child processes to finish
+    wait(NULL);
+    
+}
+
+SelfStats self_stats; //only filled with --self-stats, self_stats.sched is set while sampling
+Alerts alerts; //rules from --alert, evaluated on every sample
+Shm shm; //--shm segment, shm.seg is NULL when not publishing
+volatile sig_atomic_t stats_requested = 0; //set by SIGUSR1 to print the self stats now
+
+void handle_usr1(int signal){
+    stats_requested = 1;
+}
+
+// Adds the collector for the monitor's own CPU and RSS and starts measuring every collector
+void start_self_stats(Scheduler *sched){
+    selfstats_init(&self_stats);
+    sched_add(sched, "self", 1000000, selfstats_usage, &self_stats); //Once a second is plenty for CPU and RSS
+    selfstats_attach(&self_stats, sched);
+}
+
+// Prints the self stats to stderr if SIGUSR1 asked for them
+void check_stats_request(){
+    if(stats_requested && self_stats.sched != NULL){
+        stats_requested = 0;
+        selfstats_print(&self_stats, stderr);
+    }
+}
+
+// State shared by the collectors of the single-process mode
+typedef struct {
+    StatSample prev, curr;
+    Sample sample;
+    KernelStats *kstat; //takes the counters of every /proc/stat read, NULL without the kernel panel
+} single_state;
+
+// Evaluates the alert rules on a fresh sample and collects the hooks that finished
+void check_alerts(const Sample *s, long long ts_ns){
+    if(alerts.n > 0){
+        alert_eval(&alerts, s, ts_ns);
+        alert_reap(&alerts);
+    }
+}
+
+// Publishes a fresh sample to the --shm segment, period_ns is the interval it was taken at
+void publish_sample(const Sample *s, long long period_ns){
+    if(shm.seg != NULL){
+        shm_publish(&shm, s, period_ns);
+    }
+}
+
+// One row per alert rule with its state and its last value
+void plot_alerts(layout *l){
+    for(int i = 0; i < alerts.n; i++){
+        AlertRule *r = &alerts.rule[i];
+        char hook[32] = "";
+        if(r->hook > 0){
+            snprintf(hook, sizeof(hook), "hook running");
+        }
+        else if(r->skipped > 0){
+            snprintf(hook, sizeof(hook), "%lu skipped", r->skipped);
+        }
+        screen_printf(l->scr, l->alertrow + i, 1, "%-8s %-44.44s %10.2f %6lux %-14s", r->firing ? "FIRING" : "ok", r->text,
+                      r->value, r->fired, hook);
+    }
+}
+
+void collect_memory(void *ctx, long long ts_ns){
+    single_state *st = ctx;
+    read_memory(&st->sample); //Function to get the memory breakdown in GB
+}
+
+void collect_cpu(void *ctx, long long ts_ns){
+    single_state *st = ctx;
+    if(stat_read(&st->curr) == -1){
+        exit(1);
+    }
+    st->sample.cpu = get_cpu_percentage(st->prev.cpu, st->curr.cpu);
+    for(int c = 0; c < st->sample.ncores; c++){
+        st->sample.core[c] = get_cpu_percentage(st->prev.core[c], st->curr.core[c]);
+    }
+    if(st->kstat != NULL){
+        kstat_update(st->kstat, &st->curr, ts_ns); //Same read, only /proc/vmstat is extra
+    }
+    StatSample tmp = st->prev; //Swapping so the counter arrays are reused every sample
+    st->prev = st->curr;
+    st->curr = tmp;
+}
+
+void single_init(single_state *st, float totalram){
+    if(stat_init(&st->prev) == -1 || stat_init(&st->curr) == -1 || stat_read(&st->prev) == -1){
+        exit(1);
+    }
+    memset(&st->sample, 0, sizeof(st->sample));
+    st->sample.mem_total = totalram;
+    st->sample.ncores = st->prev.ncores < MAX_CORES ? st->prev.ncores : MAX_CORES;
+    st->kstat = NULL;
+}
+
+void single_free(single_state *st){
+    stat_free(&st->prev);
+    stat_free(&st->curr);
+}
+
+// Moves the memory and CPU collectors to the interval the adaptive rate picked for the
+// latest sample. Either may be NULL
+void adapt_collectors(Adaptive *a, const Sample *s, Scheduler *sched, Collector *mem_col, Collector *cpu_col){
+    long long period = adapt_update(a, s);
+    if(mem_col != NULL){
+        sched_set_period(sched, mem_col, period);
+    }
+    if(cpu_col != NULL){
+        sched_set_period(sched, cpu_col, period);
+    }
+}
+
+// Same graphs as plot_values, but every metric is sampled in this process off one timerfd,
+// so there is no fork/pipe overhead and memory and CPU samples share their timestamps
+void plot_values_single(layout *l, info flags){
+    single_state st;
+    Scheduler sched;
+    single_init(&st, l->totalram);
+    if(l->kstat != NULL){
+        kstat_init(l->kstat, &st.prev, now_ns());
+        st.kstat = l->kstat;
+    }
+    int per_column = flags.oversample > 1 ? flags.oversample : 1;
+    int aggregate = per_column > 1 || flags.scroll || flags.adaptive; //Columns are drawn from min/max/avg instead of single points
+    long period = flags.tdelay / per_column > 0 ? flags.tdelay / per_column : 1;
+    Adaptive adaptive;
+    if(flags.adaptive){
+        period = flags.tdelay; //Where it starts, every column still spans tdelay
+        adapt_init(&adaptive, flags.adapt_min_us, flags.adapt_max_us, period, l->totalram, cpu_count());
+        period = adaptive.period_ns / 1000;
+    }
+    Column *ring = calloc(flags.samples, sizeof(Column)); //What every column of the graphs shows, for scrolling
+    if(ring == NULL){
+        perror("calloc error, unable to allocate the graph columns");
+        exit(1);
+    }
+    if(sched_init(&sched) == -1){
+        exit(1);
+    }
+    Collector *mem_col = NULL;
+    Collector *cpu_col = NULL;
+    if(flags.memory){
+        mem_col = sched_add(&sched, "memory", period, collect_memory, &st);
+    }
+    if(flags.cpu || flags.cores || l->kstat != NULL){ //The kernel panel reads its counters with the CPU times
+        cpu_col = sched_add(&sched, "cpu", period, collect_cpu, &st);
+    }
+    if(l->disks != NULL){
+        sched_add(&sched, "disk", flags.tdelay, disk_collect, l->disks);
+    }
+    if(l->net != NULL){
+        sched_add(&sched, "net", flags.tdelay, net_collect, l->net);
+    }
+    if(l->cgroups != NULL){
+        sched_add(&sched, "cgroup", flags.tdelay, cgroup_collect, l->cgroups);
+    }
+    if(l->psi != NULL){
+        sched_add(&sched, "psi", flags.tdelay, psi_collect, l->psi);
+        l->psi->on_event = psi_event;
+        l->psi->ctx = l;
+        if(psi_watch(l->psi, &sched) == -1){
+            exit(1);
+        }
+    }
+    if(l->topo != NULL && l->topo->numa){
+        sched_add(&sched, "numa", flags.tdelay, topo_collect, l->topo);
+    }
+    if(l->freq != NULL && l->freq->source != FREQ_NONE){
+        sched_add(&sched, "freq", flags.freq_ms > 0 ? flags.freq_ms * 1000L : flags.tdelay, freq_collect, l->freq);
+    }
+    ProcTable procs;
+    if(flags.procs > 0){
+        if(procs_init(&procs, flags.procs, flags.procs_sort) == -1){
+            exit(1);
+        }
+        long period = flags.procs_ms > 0 ? flags.procs_ms * 1000L : flags.tdelay;
+        procs.budget_ns = period * 1000LL * PROCS_BUDGET_PCT / 100; //Large hosts are read a slice per tick
+        procs_scan(&procs, now_ns()); //Baseline, so the first tick already has deltas
+        sched_add(&sched, "procs", period, procs_collect, &procs);
+        l->procs = &procs;
+    }
+    if(flags.self_stats){
+        start_self_stats(&sched);
+    }
+
+    int count = 0;
+    long long max_late = 0;
+    long long first_ns = 0, last_ns = 0;
+    unsigned long taken = 0; //Samples, more than columns when oversampling
+    Column col;
+    memset(&col, 0, sizeof(col));
+    long long column_ns = flags.tdelay * 1000LL;
+    long long column_end = sched.start_ns + column_ns; //With --adaptive, columns are cut by time instead of by count
+    Collector *c = mem_col != NULL ? mem_col : cpu_col; //A new sample is complete whenever this one runs
+    while(flags.scroll || count < flags.samples){
+        unsigned long runs = c->runs;
+        int ran = sched_run_once(&sched);
+        check_stats_request();
+        if(ran == -1){
+            exit(1);
+        }
+        if(c->runs == runs){
+            continue; //Woken by a signal or by another collector
+        }
+        if(taken++ == 0){
+            first_ns = c->last_ns;
+        }
+        last_ns = c->last_ns;
+        if(c->late_ns > max_late){
+            max_late = c->late_ns;
+        }
+        st.sample.ts_ns = wall_ns();
+        check_alerts(&st.sample, c->last_ns); //Every sample, not only the ones a column shows
+        publish_sample(&st.sample, c->period_ns);
+        int due = 1; //Columns this sample completes
+        if(flags.adaptive){
+            adapt_collectors(&adaptive, &st.sample, &sched, mem_col, cpu_col);
+            if(l->history != NULL){
+                history_append(l->history, &st.sample); //Each sample at the time it was taken, not the column averages
+            }
+            due = 0;
+            while(c->last_ns >= column_end){
+                due++;
+                column_end += column_ns;
+            }
+        }
+        if(aggregate){
+            agg_add(&col.mem, st.sample.mem_used);
+            agg_add(&col.cpu, st.sample.cpu);
+            if(flags.adaptive ? due == 0 : col.cpu.n < per_column){
+                continue; //The column is not complete yet
+            }
+        }
+        long long render_start = now_ns();
+        if(!flags.scroll && due > flags.samples - count){
+            due = flags.samples - count;
+        }
+        float mem_now = st.sample.mem_used, cpu_now = st.sample.cpu;
+        for(int k = 0; k < due; k++){
+            count++;
+            if(k > 0){ //A sample longer than a column holds its value over every column it spans
+                memset(&col, 0, sizeof(col));
+                agg_add(&col.mem, mem_now);
+                agg_add(&col.cpu, cpu_now);
+            }
+            if(aggregate){
+                push_column(count, &col, ring, l, flags);
+            }
+            else{
+                if(mem_col != NULL){
+                    plot_memory(count, &st.sample, l, flags);
+                }
+                if(cpu_col != NULL){
+                    plot_cpu(count, &st.sample, l, flags);
+                }
+            }
+            if(l->net != NULL){
+                plot_net(count, l);
+            }
+            if(l->psi != NULL){
+                plot_psi(count, l);
+            }
+            if(l->kstat != NULL){
+                plot_kstat(count, l);
+            }
+        }
+        st.sample.ts_ns = wall_ns();
+        if(aggregate){
+            st.sample.mem_used = agg_avg(&col.mem); //What gets recorded is what the column shows
+            st.sample.cpu = agg_avg(&col.cpu);
+            if(mem_col != NULL){
+                memory_label(&st.sample, l);
+            }
+            if(flags.cpu){
+                screen_printf(l->scr, l->cpurow-2, 9, " %.2f %% (min %.2f, max %.2f)         ", st.sample.cpu, col.cpu.min, col.cpu.max);
+            }
+            if(flags.cores){
+                fill_cores(&st.sample, l);
+            }
+            memset(&col, 0, sizeof(col));
+        }
+        if(flags.adaptive){
+            screen_printf(l->scr, 2, 1, "Sampling every %.1f ms (%.1f to %.1f ms), %lu changes    ", adaptive.period_ns / 1e6,
+                          adaptive.min_ns / 1e6, adaptive.max_ns / 1e6, adaptive.changes);
+        }
+        if(l->disks != NULL){
+            plot_disks(l);
+        }
+        if(l->cgroups != NULL){
+            plot_cgroups(l);
+        }
+        if(l->alertrow > 0){
+            plot_alerts(l);
+        }
+        if(l->procs != NULL){
+            plot_procs(l);
+        }
+        if(flags.adaptive){
+            end_frame(l, flags); //Every sample was recorded as it came
+        }
+        else{
+            finish_tick(&st.sample, l, flags);
+        }
+        if(flags.self_stats){
+            hist_add(&self_stats.render, now_ns() - render_start);
+        }
+    }
+
+    double interval = taken > 1 ? (last_ns - first_ns) / (taken - 1) / 1000000.0 : 0;
+    screen_printf(l->scr, l->bottom, 1, "Sampled every %.3f ms on average, at most %.3f ms late. Missed deadlines: memory %lu, cpu %lu",
+                  interval, max_late / 1000000.0,
+                  mem_col != NULL ? mem_col->missed : 0, cpu_col != NULL ? cpu_col->missed : 0);
+    l->bottom++;
+    end_frame(l, flags);
+    if(flags.self_stats){
+        printf("\033[%d;%dH", l->bottom, 1);
+        l->bottom += selfstats_print(&self_stats, stdout); //Under the graphs, where the run ends
+        self_stats.sched = NULL;
+    }
+    sched_close(&sched);
+    if(l->procs != NULL){
+        procs_free(&procs);
+        l->procs = NULL;
+    }
+    free(ring);
+    single_free(&st);
+}
+
+volatile sig_atomic_t stop_requested = 0; //set by Ctrl-C or SIGTERM in headless mode
+
+void handle_stop(int signal){
+    stop_requested = 1;
+}
+
+// Opens the --record file, returns NULL when not recording
+History *open_record(info flags, History *record){
+    if(flags.record == NULL || flags.replay != NULL){
+        return NULL;
+    }
+    int ncores = cpu_count() < MAX_CORES ? cpu_count() : MAX_CORES;
+    if(history_create(record, flags.record, ncores, (size_t)flags.record_max * 1024 * 1024) == -1){
+        exit(1);
+    }
+    return record;
+}
+
+// Samples like --single but writes one record per tick in flags.format instead of drawing.
+// Runs until flags.samples records are written, forever when it is 0, or until Ctrl-C
+void run_headless(info flags){
+    single_state st;
+    Scheduler sched;
+    Output out;
+    History record;
+    single_init(&st, get_ram());
+    int ncores = flags.cores ? st.sample.ncores : 0; //Only the aggregate CPU is written
+    if(flags.shm == NULL){
+        st.sample.ncores = ncores; //Nothing else needs the per-core values
+    }
+    History *history = open_record(flags, &record);
+    Output *output = NULL;
+    if(flags.format != -1){
+        if(output_open(&out, flags.output, flags.format, ncores, flags.flush_every, flags.flush_ms) == -1){
+            exit(1);
+        }
+        output = &out;
+    }
+    Agent agent;
+    if(flags.agent != NULL){
+        char host[AGENT_NAME];
+        if(gethostname(host, sizeof(host)) == -1){
+            snprintf(host, sizeof(host), "agent-%d", getpid());
+        }
+        host[sizeof(host) - 1] = '\0';
+        if(agent_open(&agent, flags.agent, flags.agent_name != NULL ? flags.agent_name : host, ncores) == -1){
+            exit(1);
+        }
+    }
+    if(sched_init(&sched) == -1){
+        exit(1);
+    }
+    Adaptive adaptive;
+    long period = flags.tdelay;
+    if(flags.adaptive){
+        adapt_init(&adaptive, flags.adapt_min_us, flags.adapt_max_us, flags.tdelay, st.sample.mem_total, cpu_count());
+        period = adaptive.period_ns / 1000;
+    }
+    Collector *mem_col = sched_add(&sched, "memory", period, collect_memory, &st);
+    Collector *c = sched_add(&sched, "cpu", period, collect_cpu, &st); //A record is complete whenever this one runs
+    if(flags.self_stats){
+        start_self_stats(&sched);
+    }
+
+    long count = 0;
+    while((flags.samples == 0 || count < flags.samples) && !stop_requested){
+        unsigned long runs = c->runs;
+        int ran = sched_run_once(&sched);
+        check_stats_request();
+        if(ran == -1){
+            exit(1);
+        }
+        if(c->runs == runs){
+            continue; //Woken by a signal or by another collector
+        }
+        long long render_start = now_ns();
+        count++;
+        st.sample.ts_ns = wall_ns(); //Records carry their own time, so an adaptive rate needs nothing else
+        check_alerts(&st.sample, c->last_ns);
+        publish_sample(&st.sample, c->period_ns);
+        if(flags.adaptive){
+            adapt_collectors(&adaptive, &st.sample, &sched, mem_col, c);
+        }
+        if(history != NULL){
+            history_append(history, &st.sample);
+        }
+        if(output != NULL && output_write(output, &st.sample) == -1){
+            break; //Whoever reads the output went away
+        }
+        if(flags.agent != NULL){
+            agent_send(&agent, &st.sample); //Dropped while the collector is away
+        }
+        if(flags.self_stats){
+            hist_add(&self_stats.render, now_ns() - render_start);
+        }
+    }
+
+    if(output != NULL){
+        output_close(output);
+    }
+    if(flags.agent != NULL){
+        fprintf(stderr, "Sent %lu samples, dropped %lu while the collector was away\n", agent.sent, agent.dropped);
+        agent_close(&agent);
+    }
+    if(flags.self_stats){
+        selfstats_print(&self_stats, stderr); //stdout carries the records
+        self_stats.sched = NULL;
+    }
+    sched_close(&sched);
+    if(history != NULL){
+        history_close(history);
+    }
+    single_free(&st);
+}
+
+// Draws one row per agent, in the order they first connected
+void plot_fleet(void *ctx, long long ts_ns){
+    layout *l = ctx;
+    Fleet *f = l->fleet;
+    static const char levels[] = " _.-:=+*#"; //Low to high CPU in the history column
+    screen_printf(l->scr, 1, 1, "Collector: %d agents   ", f->n);
+    for(int i = 0; i < f->n; i++){
+        Peer *p = f->peer[i];
+        char history[AGENT_HISTORY + 1];
+        int shown = p->frames < AGENT_HISTORY ? p->frames : AGENT_HISTORY;
+        for(int k = 0; k < AGENT_HISTORY; k++){
+            history[k] = ' ';
+            if(k >= AGENT_HISTORY - shown){ //Oldest on the left, the latest in the last column
+                float cpu = p->history[(p->frames - AGENT_HISTORY + k) % AGENT_HISTORY];
+                int level = (int)(cpu / 100 * (sizeof(levels) - 2) + 0.5);
+                history[k] = levels[level < 0 ? 0 : level > (int)sizeof(levels) - 2 ? (int)sizeof(levels) - 2 : level];
+            }
+        }
+        history[AGENT_HISTORY] = '\0';
+        char status[16];
+        if(p->fd == -1){
+            snprintf(status, sizeof(status), "gone");
+        }
+        else if(p->frames == 0){
+            snprintf(status, sizeof(status), "waiting");
+        }
+        else{
+            snprintf(status, sizeof(status), "%.1fs ago", (ts_ns - p->last_ns) / 1e9);
+        }
+        screen_printf(l->scr, l->bottom + i, 1, "%-20.20s %6.1f%% |%s| %6.2f / %-6.2f GB %5d %9lu %-10s", p->hello.name,
+                      p->last.cpu, history, p->last.mem_used, p->last.mem_total, p->last.ncores, p->frames, status);
+    }
+    for(int i = f->n; i < AGENT_PEERS; i++){
+        screen_fill(l->scr, l->bottom + i, 1, l->scr->cols, ' '); //Rows of agents that were dropped
+    }
+    screen_flush(l->scr, l->bottom + f->n);
+}
+
+// Writes every record an agent sends as it arrives
+void export_sample(void *ctx, Peer *p){
+    if(output_write_labelled(ctx, p->hello.name, &p->last) == -1){
+        stop_requested = 1; //Whoever reads the output went away
+    }
+}
+
+void flush_output(void *ctx, long long ts_ns){
+    output_flush(ctx);
+}
+
+// Accepts agents on flags.collector and shows them side by side, redrawn every tdelay.
+// With --format nothing is drawn, every record is written with the agent's name instead
+void run_collector(info flags){
+    Scheduler sched;
+    Fleet fleet;
+    Output out;
+    Screen scr;
+    layout l;
+    memset(&l, 0, sizeof(l));
+    if(sched_init(&sched) == -1 || fleet_open(&fleet, flags.collector, &sched) == -1){
+        exit(1);
+    }
+    if(flags.format != -1){
+        if(output_open_labelled(&out, flags.output, flags.format, flags.flush_every, flags.flush_ms) == -1){
+            exit(1);
+        }
+        fleet.on_sample = export_sample;
+        fleet.ctx = &out;
+        if(flags.flush_ms > 0){
+            sched_add(&sched, "flush", flags.flush_ms * 1000L, flush_output, &out); //Quiet agents still get flushed
         }
     }
     else{
-        close(mem_pipe[0]); // Close read end of memory pipe
-    }
-
-    if(flags.cpu){
-        pid_t c_pid = fork(); //Creating a child process to get the CPU utilization values
-        if(c_pid == -1){
-            perror("error creating child process");
+        clear_screen();
+        fflush(stdout);
+        if(screen_init(&scr, STDOUT_FILENO, AGENT_PEERS + 6, 120) == -1){
             exit(1);
         }
-        if(c_pid == 0){
-            //reset handler for ctrl c using signal to ignore 
-            signal(SIGINT, SIG_IGN);
-            cpu_child(cpu_pipe, flags); //Function to get the CPU utilization values
-            exit(0); //Exiting the child process
+        l.scr = &scr;
+        l.fleet = &fleet;
+        l.bottom = 5;
+        screen_printf(&scr, 2, 1, "Listening on %s, refreshed every %.3f secs", flags.collector, flags.tdelay / 1000000.0);
+        screen_printf(&scr, 4, 1, "%-20s %7s  %-*s  %-17s %5s %9s %-10s", "AGENT", "CPU", AGENT_HISTORY, "CPU HISTORY",
+                      "MEMORY", "CORES", "SAMPLES", "LAST");
+        sched_add(&sched, "render", flags.tdelay, plot_fleet, &l);
+    }
+    if(flags.self_stats){
+        start_self_stats(&sched);
+    }
+    while(!stop_requested){
+        int ran = sched_run_once(&sched);
+        check_stats_request();
+        if(ran == -1){
+            exit(1);
         }
     }
+    if(flags.format != -1){
+        output_close(&out);
+    }
     else{
-        close(cpu_pipe[0]); // Close read end of CPU pipe
+        reset_cursor(l.bottom + fleet.n);
+        screen_free(&scr);
     }
-
-    close(mem_pipe[1]); // Close write end of memory pipe
-    close(cpu_pipe[1]); // Close write end of CPU pipe
-
-    int mem_y;
-    float cpu_val;
-    float totalram = (float)get_ram();
-    int mem_read = read(mem_pipe[0], &mem_y, sizeof(mem_y));
-    int cpu_read = read(cpu_pipe[0], &cpu_val, sizeof(cpu_val)); //Reading the values of memory and cpu utilization from the pipes
-    int mcount = 0;
-    int ccount = 0; // maintaining the count of the number of points plotted for memory and cpu utilization
-
-    while((flags.memory && mcount < flags.samples) || (flags.cpu &&  ccount < flags.samples)){
-        if(flags.memory && mem_read > 0 && mcount < flags.samples){
-            plot_point(mcount + 1, mem_y, MEM_SCALE, mrow, "#"); //Function to plot the point for memory utilization
-            char label[200];
-            float val = (mem_y/(float)MEM_SCALE) * totalram;
-            sprintf(label, "%.2f GB            ", val);
-            printf("\033[%d;%dH %s", mrow-2, 9,label);
-            reset_cursor(cpurow + 200);
-            fflush(stdout); //Printing the memory utilization above its graph
-            mcount++;
-        }
-        if(flags.cpu && cpu_read > 0 && ccount < flags.samples){
-            plot_point(ccount + 1,cpu_val/10, CPU_Y, cpurow, ":"); //Function to plot the point for CPU utilization
-            char label[200];
-            sprintf(label, "%.2f %%", cpu_val);
-            printf("\033[%d;%dH %s         ", cpurow-2, 9,label); //Printing the CPU utilization above its graph
-            reset_cursor(cpurow + 200);
-            fflush(stdout);
-            ccount++;
-        }
-        mem_read = read(mem_pipe[0], &mem_y, sizeof(mem_y));
-        cpu_read = read(cpu_pipe[0], &cpu_val, sizeof(cpu_val)); //Reading the values of memory and cpu utilization from the pipes
+    if(flags.self_stats){
+        selfstats_print(&self_stats, stderr);
+        self_stats.sched = NULL;
     }
-    reset_cursor(cpurow + 20); //Function to reset the cursor to avoid overwriting the graph
-    close(mem_pipe[0]); // Close read end of memory pipe
-    close(cpu_pipe[0]); // Close read end of CPU pipe
-    wait(NULL); //Waiting for the child processes to finish
-    wait(NULL);
-    
+    fleet_close(&fleet);
+    sched_close(&sched);
 }
 
-void draw_core(int x, int y){
-    //Drawing the core
-    for(int i =0; i < 3; i++){
-        if(i == 0){
-            printf("\033[%d;%dH+", y, x);
-            printf("\033[%d;%dH|", y+1, x);
-            printf("\033[%d;%dH+", y+2, x);
-        }
-        else if(i == 1){
-            printf("\033[%d;%dH--", y, x+1);
-            printf("\033[%d;%dH--", y+2, x+1);
+// Feeds a recording back through the same plotting path, paced by the recorded timestamps
+// divided by speed. A speed of 0 plots as fast as possible
+void plot_replay(History *replay, layout *l, info flags){
+    uint64_t count = history_count(replay);
+    if(count > (uint64_t)flags.samples){
+        count = flags.samples;
+    }
+    Sample sample;
+    long long prev_ts = 0;
+    long long due = now_ns();
+
+    for(uint64_t i = 0; i < count; i++){
+        history_get(replay, i, &sample);
+        if(flags.replay_speed > 0){
+            long long gap = i == 0 ? 0 : (long long)((sample.ts_ns - prev_ts) / flags.replay_speed);
+            if(gap < 0 || gap > 1000000000LL){
+                gap = 1000000000LL; //Gaps between recording sessions are shortened to a second
+            }
+            due += gap;
+            struct timespec ts = { due / 1000000000LL, due % 1000000000LL };
+            while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR); //Absolute, so pacing does not drift
         }
-        else{
-            printf("\033[%d;%dH+", y, x+3);
-            printf("\033[%d;%dH|", y+1, x+3);
-            printf("\033[%d;%dH+", y+2, x+3);
+        prev_ts = sample.ts_ns;
+        if(flags.memory){
+            plot_memory(i + 1, &sample, l, flags);
         }
-    }
-}
-void plot_cores(int cores, int coresrow){
-    int height = sqrt(cores); //Calculating the height of the square
-    int width = cores/height; //Calculating the width of the square
-
-    int count = 0; 
-    int y = coresrow;
-
-    for (int i = 0; i < cores; i++) {
-
-        if (count == width){
-            y = y + 5;
-            count = 0;
+        if(flags.cpu || flags.cores){
+            plot_cpu(i + 1, &sample, l, flags);
         }
-        draw_core(1 + 8* count, y); //Function to draw the core
-        count++;
+        finish_tick(&sample, l, flags);
     }
-    reset_cursor(coresrow + 200); //Function to reset the cursor to avoid overwriting the graph
 }
 
 void cores_child(int cores_pipe[]){
 
     close(cores_pipe[0]); // Close read end of cores pipe
-    FILE *file = fopen("/proc/cpuinfo", "r"); //Opening the file /proc/cpuinfo to get the number of cores
-    if (file == NULL) {
+    int cores = cpu_online_count(); //One small sysfs list instead of all of /proc/cpuinfo
+    if (cores == -1) {
+        cores = cpuinfo_count(); //Counting the processors in /proc/cpuinfo
+    }
+    if (cores == -1) {
         perror("fopen error, unable to read /proc/cpuinfo");
         close(cores_pipe[1]);
         return;
     }
-    char buffer[1024];  
-    int cores = 0;  
-    while (fgets(buffer, sizeof(buffer), file)) {
-        if (strstr(buffer, "processor")) {
-            cores++; //Incrementing the number of cores
-        }
-    }
-    fclose(file); //Closing the file
     if(write(cores_pipe[1], &cores, sizeof(cores)) == -1){ //Writing the number of cores to the pipe
         perror("error writing to cores pipe");
         exit(1);
@@ -314,29 +1709,31 @@ void cores_child(int cores_pipe[]){
 
 void freq_child(int freq_pipe[]){
     close(freq_pipe[0]); // Close read end of frequency pipe
-    FILE *max_freq_file = fopen("/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq", "r"); //Opening the file to get the max frequency
-    if (max_freq_file)
+    ProcFile max_freq_file;
+    char path[PATH_MAX];
+    if (proc_open(&max_freq_file, proc_path("/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq", path)) == 0) //Opening the file to get the max frequency
     {
-        float base_freq_ghz = 0.0;
-        if(fscanf(max_freq_file, "%f", &base_freq_ghz) == 0){ //Reading the frequency from the file
+        if(proc_read(&max_freq_file) <= 0){ //Reading the frequency from the file
             perror("error reading from /sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq");
             exit(1);
         }
-        base_freq_ghz = base_freq_ghz / 1000000.0; // KHz → GHz
+        const char *p = max_freq_file.buf;
+        float base_freq_ghz = scan_u64(&p) / 1000000.0; // KHz → GHz
         if(write(freq_pipe[1], &base_freq_ghz, sizeof(base_freq_ghz)) == -1){ //Writing the frequency to the pipe
             perror("error writing to frequency pipe");
             exit(1);
         }
-        fclose(max_freq_file); //Closing the file
+        proc_close(&max_freq_file); //Closing the file
     }
     else
     {
-        perror("fopen error, unable to read /sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq");
+        perror("open error, unable to read /sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq");
     }
     close(freq_pipe[1]); // Close write end of frequency pipe
 }
 
-void show_cores(int coresrow){
+// Gets the number of cores and their base frequency from two child processes
+int read_cores(float *base_freq_ghz){
     int cores_pipe[2]; //Creating a pipe to get the number of cores
     int freq_pipe[2]; //Creating a pipe to get the frequency
     int a = pipe(cores_pipe);
@@ -369,25 +1766,16 @@ void show_cores(int coresrow){
     close(cores_pipe[1]); // Close write end of cores pipe
     close(freq_pipe[1]); // Close write end of frequency pipe
 
-    int cores;
-    float base_freq_ghz;
+    int cores = 0;
     
     while(read(cores_pipe[0], &cores, sizeof(cores)) > 0); //Reading the number of cores from the pipe
-    while(read(freq_pipe[0], &base_freq_ghz, sizeof(base_freq_ghz)) > 0); //Reading the frequency from the pipe
-
-
-
-    char label[200];
-    sprintf(label, "Number of Cores: %d @ %.2f Ghz", cores,base_freq_ghz);
-    printf("\033[%d;%dH %s", coresrow-2, 1,label); //Printing the number of cores and frequency
-
-    plot_cores(cores,coresrow); //Function to plot the number of cores and frequency
+    while(read(freq_pipe[0], base_freq_ghz, sizeof(*base_freq_ghz)) > 0); //Reading the frequency from the pipe
 
     close(cores_pipe[0]); // Close read end of cores pipe
     close(freq_pipe[0]); // Close read end of frequency pipe
     wait(NULL); //Waiting for the child processes to finish
     wait(NULL);
-
+    return cores;
 }
 
 
@@ -396,38 +1784,374 @@ void show_cores(int coresrow){
 
 
 void show(info flags){
-    clear_screen(); //Function to clear the screen
-    printf("Nbr of samples: %d -- every %d microSecs ( %.3fsecs)\n\n", flags.samples, flags.tdelay, flags.tdelay/1000000.0); //Printing the values of samples and tdelay
-    char label[20];
     int mrow = 5;
     int cpurow = 5;
     int coresrow = 5; //Variables to keep track of the row  for memory, cpu and cores
+    int cores = 0;
+    float base_freq_ghz = 0;
 
     if(flags.memory){
-        printf("\033[%d;%dH%s", mrow-2, 1,"v Memory  ");
-        sprintf(label, "%d GB", get_ram());
-        draw_axes(MEM_SCALE,flags.samples,"0 GB",label,mrow); //Function to draw the axes
         cpurow = 22;
         coresrow = 22;
     }
     if(flags.cpu){
-        printf("\033[%d;%dH%s", cpurow-2, 1,"v CPU  ");
-        draw_axes(CPU_Y,flags.samples,"  0%","100%",cpurow); //Function to draw the axes
         coresrow = coresrow + 16;
     }
-    
+    History replay;
+    Sample first;
+    if(flags.replay != NULL){
+        if(history_open(&replay, flags.replay) == -1){
+            exit(1);
+        }
+        if(history_count(&replay) == 0){
+            fprintf(stderr, "%s has no samples\n", flags.replay);
+            exit(1);
+        }
+        history_get(&replay, 0, &first);
+        if(flags.cores){
+            cores = first.ncores; //The grid of the machine that was recorded
+        }
+    }
+    else if(flags.cores){
+        cores = read_cores(&base_freq_ghz); //Function to get the number of cores
+    }
+    Topology topo;
+    int grouped = 0;
+    if(flags.cores && flags.replay == NULL){
+        if(topo_init(&topo) == -1){
+            exit(1);
+        }
+        grouped = topo.nonline > 0;
+        if(!grouped){
+            topo_free(&topo); //Nothing to group, the flat grid then
+        }
+    }
+
+    layout l;
+    l.mrow = mrow;
+    l.cpurow = cpurow;
+    l.coresrow = coresrow;
+    l.cores = cores;
+    l.bottom = coresrow + 1;
+    int cols = offset + graph_cells(flags.samples, flags.braille) + 2;
+    l.topo = NULL;
+    l.cell = NULL;
+    l.block = NULL;
+    if(grouped){
+        l.topo = &topo;
+        l.cores = topo.ncpus; //Cells are indexed by cpu id, offline ones have none
+        l.cell = calloc(topo.ncpus, sizeof(Cell));
+        l.block = calloc(topo.nnodes, sizeof(Cell));
+        if(l.cell == NULL || l.block == NULL){
+            perror("calloc error, unable to allocate the cores grid");
+            exit(1);
+        }
+        int width = grid_layout(&l, cols > 120 ? cols : 120);
+        if(width > cols){
+            cols = width;
+        }
+    }
+    else if(cores > 0){
+        int x, y;
+        core_position(cores - 1, cores, coresrow, &x, &y);
+        l.bottom = y + 5; //Below the percentage row of the last line of cores
+        int width = cores / (int)sqrt(cores); //Same width as core_position uses
+        if(8 * width > cols){
+            cols = 8 * width; //Wide enough for the last core of a row
+        }
+    }
+    if(cols < 120){
+        cols = 120; //Room for the labels and the summary lines
+    }
+    l.totalram = flags.replay != NULL ? first.mem_total : get_ram();
+    if(l.totalram <= 0){
+        l.totalram = 1; //A recording without memory samples
+    }
+
+    DiskTable disks;
+    l.disks = NULL;
+    l.diskrow = 0;
+    l.disk_rows = 0;
+    if(flags.disks && flags.replay == NULL){
+        if(disk_init(&disks, flags.disk_filter) == -1){
+            exit(1);
+        }
+        l.disks = &disks;
+        l.disk_rows = disks.nshown < DISK_ROWS ? disks.nshown : DISK_ROWS;
+        l.diskrow = l.bottom + 3;
+        l.bottom = l.diskrow + l.disk_rows + 2;
+    }
+    NetTable net;
+    l.net = NULL;
+    l.netrow = 0;
+    l.net_rows = 0;
+    l.net_rx = l.net_tx = NULL;
+    l.net_points = 0;
+    l.net_cols = flags.samples;
+    l.net_scale = 0;
+    if(flags.net && flags.replay == NULL){
+        l.net_rx = calloc(flags.samples, sizeof(float));
+        l.net_tx = calloc(flags.samples, sizeof(float));
+        if(l.net_rx == NULL || l.net_tx == NULL){
+            perror("calloc error, unable to allocate the network graph");
+            exit(1);
+        }
+        if(net_init(&net) == -1){
+            exit(1);
+        }
+        l.net = &net;
+        l.net_rows = net.n < NET_ROWS ? net.n : NET_ROWS;
+        l.netrow = l.bottom + 3;
+        l.bottom = l.netrow + NET_Y + 3 + l.net_rows + 1; //The graph, then the table under it
+    }
+    PsiTable psi;
+    l.psi = NULL;
+    l.psirow = 0;
+    l.psi_vals = NULL;
+    l.psi_points = 0;
+    l.psi_scale = 0;
+    if(flags.psi && flags.replay == NULL){
+        l.psi_vals = calloc((size_t)flags.samples * PSI_SERIES, sizeof(float));
+        if(l.psi_vals == NULL){
+            perror("calloc error, unable to allocate the pressure graph");
+            exit(1);
+        }
+        if(psi_init(&psi, flags.psi_stall_ms * 1000L, flags.psi_window_ms * 1000L) == -1){
+            exit(1);
+        }
+        l.psi = &psi;
+        l.psirow = l.bottom + 3;
+        l.bottom = l.psirow + PSI_Y + 3 + PSI_RESOURCES + 1; //The graph, then the table under it
+    }
+    CgroupTable cgroups;
+    l.cgroups = NULL;
+    l.cgrouprow = 0;
+    l.cgroup_rows = 0;
+    if(flags.cgroup != NULL && flags.replay == NULL){
+        if(cgroup_init(&cgroups, flags.cgroup, flags.cgroup_subtree, CGROUP_ROWS) == -1){
+            exit(1);
+        }
+        l.cgroups = &cgroups;
+        l.cgroup_rows = flags.cgroup_subtree ? CGROUP_ROWS : 1; //Fixed, so cgroups that come and go do not move the panels below
+        l.cgrouprow = l.bottom + 3;
+        l.bottom = l.cgrouprow + l.cgroup_rows + 2;
+    }
+    KernelStats kstat;
+    l.kstat = NULL;
+    l.kstatrow = 0;
+    l.kstat_vals = NULL;
+    l.kstat_points = 0;
+    if(flags.kernel && flags.replay == NULL){
+        l.kstat_vals = calloc((size_t)flags.samples * KSTAT_SERIES, sizeof(float));
+        if(l.kstat_vals == NULL){
+            perror("calloc error, unable to allocate the kernel activity graph");
+            exit(1);
+        }
+        l.kstat = &kstat; //Set up by plot_values_single from its first /proc/stat read
+        l.kstatrow = l.bottom + 3;
+        l.bottom = l.kstatrow + KSTAT_SERIES + 2;
+    }
+    FreqTable freq;
+    l.freq = NULL;
+    if(cores > 0 && flags.replay == NULL){
+        if(freq_init(&freq, l.cores) == -1){
+            exit(1);
+        }
+        l.freq = &freq;
+    }
+    l.alertrow = 0;
+    if(alerts.n > 0 && flags.replay == NULL){
+        l.alertrow = l.bottom + 3;
+        l.bottom = l.alertrow + alerts.n + 1;
+    }
+    l.procs = NULL;
+    l.procrow = 0;
+    if(flags.procs > 0 && flags.replay == NULL){ //Processes are not recorded, so there is nothing to replay
+        l.procrow = l.bottom + 3;
+        l.bottom = l.procrow + flags.procs + 2;
+    }
+
+    History record;
+    l.history = open_record(flags, &record);
+
+    Screen scr;
+    clear_screen(); //Function to clear the screen
+    fflush(stdout);
+    if(screen_init(&scr, STDOUT_FILENO, l.bottom + 2, cols) == -1){
+        exit(1);
+    }
+    l.scr = &scr;
+    Canvas mem_canvas, cpu_canvas, net_canvas, psi_canvas;
+    l.mem_canvas = l.cpu_canvas = l.net_canvas = l.psi_canvas = NULL;
+    l.braille = flags.braille;
+    if(flags.braille){ //Inside the axes, one cell right of the Y axis and above the X axis
+        int width = graph_cells(flags.samples, 1);
+        if((flags.memory && canvas_init(l.mem_canvas = &mem_canvas, &scr, mrow, offset + 1, MEM_SCALE, width) == -1)
+           || (flags.cpu && canvas_init(l.cpu_canvas = &cpu_canvas, &scr, cpurow, offset + 1, CPU_Y, width) == -1)
+           || (l.net != NULL && canvas_init(l.net_canvas = &net_canvas, &scr, l.netrow, offset + 1, NET_Y, width) == -1)
+           || (l.psi != NULL && canvas_init(l.psi_canvas = &psi_canvas, &scr, l.psirow, offset + 1, PSI_Y, width) == -1)){
+            exit(1);
+        }
+    }
+
+    if(flags.scroll){
+        screen_printf(&scr, 1, 1, "Scrolling -- one column every %d microSecs ( %.3fsecs)", flags.tdelay, flags.tdelay/1000000.0);
+    }
+    else{
+        screen_printf(&scr, 1, 1, "Nbr of samples: %d -- every %d microSecs ( %.3fsecs)", flags.samples, flags.tdelay, flags.tdelay/1000000.0); //Printing the values of samples and tdelay
+    }
+    if(flags.adaptive){
+        screen_printf(&scr, 2, 1, "Sampling every %.1f to %.1f ms, '.' spans the min to max of each column", flags.adapt_min_us / 1000.0,
+                      flags.adapt_max_us / 1000.0); //Replaced by the live interval once sampling starts
+    }
+    else if(flags.oversample > 1){
+        screen_printf(&scr, 2, 1, "%d samples per column, '.' spans their min to max", flags.oversample);
+    }
+    if(flags.memory){
+        char label[20];
+        screen_put(&scr, mrow-2, 1, "v Memory  ");
+        snprintf(label, sizeof(label), "%.1f GB", l.totalram);
+        draw_axes(&scr, MEM_SCALE,graph_cells(flags.samples, flags.braille),"0 GB",label,mrow); //Function to draw the axes
+    }
+    if(flags.cpu){
+        screen_put(&scr, cpurow-2, 1, "v CPU  ");
+        draw_axes(&scr, CPU_Y,graph_cells(flags.samples, flags.braille),"  0%","100%",cpurow); //Function to draw the axes
+    }
     if(flags.cores){
-        show_cores(coresrow); //Function to show the number of cores
+        if(flags.replay != NULL){
+            screen_printf(&scr, coresrow-2, 1, " Number of Cores: %d (recorded)", cores);
+        }
+        else if(l.topo != NULL){
+            screen_printf(&scr, coresrow-2, 1, " Number of Cores: %d @ %.2f Ghz, %d socket%s, %d thread%s per core, %s", topo.nonline,
+                          base_freq_ghz, topo.npackages, topo.npackages == 1 ? "" : "s", topo.smt, topo.smt == 1 ? "" : "s",
+                          topo.numa ? "grouped by NUMA node" : "grouped by socket");
+        }
+        else{
+            screen_printf(&scr, coresrow-2, 1, " Number of Cores: %d @ %.2f Ghz", cores, base_freq_ghz); //Printing the number of cores and frequency
+        }
+        plot_cores(&l); //Function to plot the number of cores
+        if(l.freq != NULL && l.freq->source == FREQ_NONE){
+            screen_put(&scr, coresrow-1, 1, " (no per-core clocks on this host)");
+        }
+    }
+    if(l.net != NULL){
+        screen_put(&scr, l.netrow-2, 1, " Network");
+        draw_axes(&scr, NET_Y, graph_cells(flags.samples, flags.braille), "  0", "", l.netrow); //The top label is set with the first scale
+        screen_printf(&scr, l.netrow + NET_Y + 2, 1, "%-12s %10s %10s %10s %10s %8s %8s", "IFACE", "RX MB/s", "TX MB/s",
+                      "RX pkt/s", "TX pkt/s", "RX drop", "TX drop");
+    }
+    if(l.psi != NULL){
+        const char *legend = flags.braille ? "some cpu yellow, memory green, io cyan, full red, magenta, blue" : "some c m i, full C M I";
+        if(psi.triggers > 0){
+            screen_printf(&scr, l.psirow-2, 1, " Pressure stall, avg10 %s -- trigger: %ld ms stalled within %ld ms",
+                          legend, psi.stall_us / 1000, psi.window_us / 1000);
+        }
+        else{
+            screen_printf(&scr, l.psirow-2, 1, " Pressure stall, avg10 %s -- no triggers, polling only", legend);
+        }
+        draw_axes(&scr, PSI_Y, graph_cells(flags.samples, flags.braille), "  0%", "", l.psirow);
+        screen_printf(&scr, l.psirow + PSI_Y + 2, 1, "%-8s %7s %7s %7s %9s %7s %9s %8s %-12s", "PSI", "SOME10", "SOME60",
+                      "SOME300", "SOME ms/s", "FULL10", "FULL ms/s", "EVENTS", "LAST EVENT");
+    }
+    if(l.kstat != NULL){
+        screen_put(&scr, l.kstatrow-2, 1, " Kernel activity, each graph scaled to its own peak");
+        screen_printf(&scr, l.kstatrow, 1, "%-10s %8s %8s  %s", "COUNTER", "NOW", "PEAK", "HISTORY");
+    }
+    if(l.cgroups != NULL){
+        screen_put(&scr, l.cgrouprow-2, 1, " Cgroups");
+        screen_printf(&scr, l.cgrouprow, 1, "%-36s %7s %6s %7s %8s %10s %10s %6s", "CGROUP", "CPU%", "OF", "THROT%",
+                      "THR ms/s", "MEM MB", "MAX MB", "MEM%");
+    }
+    if(l.alertrow > 0){
+        screen_printf(&scr, l.alertrow-2, 1, " Alerts%s%s%s%s", flags.alert_exec != NULL ? " -- runs: " : "",
+                      flags.alert_exec != NULL ? flags.alert_exec : "", flags.alert_fifo != NULL ? " -- FIFO: " : "",
+                      flags.alert_fifo != NULL ? flags.alert_fifo : "");
+    }
+    if(l.disks != NULL){
+        screen_printf(&scr, l.diskrow-2, 1, " Disks: %d of %d devices", disks.nshown, disks.ndev);
+        screen_printf(&scr, l.diskrow, 1, "%-12s %10s %10s %8s %8s %7s %6s", "DEVICE", "READ MB/s", "WRITE MB/s",
+                      "IOPS", "AWAIT ms", "QUEUE", "UTIL%");
+    }
+    if(l.procrow > 0){
+        screen_put(&scr, l.procrow-2, 1, " Processes");
+        screen_printf(&scr, l.procrow, 1, "%7s  %-16s %7s %10s", "PID", "COMMAND", "CPU%", "RSS MB");
+    }
+    end_frame(&l, flags);
+
+    //Function to plot the values of memory and cpu utilization, and the live load of each core
+    if(flags.replay != NULL){
+        plot_replay(&replay, &l, flags);
+        history_close(&replay);
+    }
+    else if(flags.memory || flags.cpu || flags.cores){
+        if(flags.single){
+            plot_values_single(&l, flags);
+        }
+        else{
+            plot_values(&l, flags); //Function to plot the values of memory and cpu utilization
+        }
     }
 
-    //Function to plot the values of memory and cpu utilization
-    if(flags.memory || flags.cpu){
-        plot_values(mrow, cpurow, flags); //Function to plot the values of memory and cpu utilization
+    if(flags.frame_stats){
+        screen_printf(&scr, l.bottom, 1, "Sent %llu bytes in %lu frames, %.0f bytes/frame on average",
+                      scr.total_bytes, scr.frames, scr.frames > 0 ? (double)scr.total_bytes / scr.frames : 0.0);
+        l.bottom++;
+        end_frame(&l, flags);
+    }
+    reset_cursor(l.bottom); //Function to reset the cursor to avoid overwriting the graph
+    screen_free(&scr);
+    if(l.history != NULL){
+        history_close(l.history);
+    }
+    if(l.disks != NULL){
+        disk_free(l.disks);
+    }
+    if(l.net != NULL){
+        net_free(l.net);
+    }
+    if(l.freq != NULL){
+        freq_free(l.freq);
     }
+    if(l.psi != NULL){
+        psi_free(l.psi);
+    }
+    if(l.cgroups != NULL){
+        cgroup_free(l.cgroups);
+    }
+    if(l.topo != NULL){
+        topo_free(l.topo);
+    }
+    free(l.cell);
+    free(l.block);
+    Canvas *canvases[] = { l.mem_canvas, l.cpu_canvas, l.net_canvas, l.psi_canvas };
+    for(int i = 0; i < 4; i++){
+        if(canvases[i] != NULL){
+            canvas_free(canvases[i]);
+        }
+    }
+    free(l.psi_vals);
+    free(l.kstat_vals);
+    free(l.net_rx);
+    free(l.net_tx);
+}
 
-    reset_cursor(coresrow + 20); //Function to reset the cursor to avoid overwriting the grap
+
+// Returns the part after "--name=" if arg is that option, NULL otherwise
+const char *option_value(const char *arg, const char *prefix){
+    size_t len = strlen(prefix);
+    return strncmp(arg, prefix, len) == 0 ? arg + len : NULL;
 }
 
+// Parses the number of an option, anything else is a wrong input
+long option_number(const char *value){
+    char *end_ptr;
+    long num = strtol(value, &end_ptr, 10);
+    if(*value == '\0' || *end_ptr != '\0' || num < 0){
+        printf("Wrong format of inputs, refer to readme\n");
+        exit(1);
+    }
+    return num;
+}
 
 void process_flags(int argc, char ** argv, info *flags){
     int s = 0;
@@ -481,6 +2205,181 @@ void process_flags(int argc, char ** argv, info *flags){
 
             }
 
+            else if(strcmp(argv[i], "--single") == 0){
+                flags->single = 1; //Sample every metric from one process off a single timer
+            }
+
+            else if(strcmp(argv[i], "--braille") == 0){
+                flags->braille = 1; //Graphs in Braille dots, several series in color per graph
+            }
+            else if(strcmp(argv[i], "--mem-stack") == 0){
+                flags->mem_stack = 1; //Cache and swap stacked on the used memory
+            }
+
+            else if(strcmp(argv[i], "--frame-stats") == 0){
+                flags->frame_stats = 1; //Show the bytes sent to the terminal per frame
+            }
+
+            else if(option_value(argv[i], "--record=") != NULL){
+                flags->record = (char *)option_value(argv[i], "--record="); //Append every sample to this file
+            }
+            else if(option_value(argv[i], "--record-max=") != NULL){
+                flags->record_max = option_number(option_value(argv[i], "--record-max="));
+            }
+            else if(option_value(argv[i], "--replay=") != NULL){
+                flags->replay = (char *)option_value(argv[i], "--replay="); //Plot a recording instead of this machine
+            }
+            else if(strcmp(argv[i], "--self-stats") == 0){
+                flags->self_stats = 1; //Measure the monitor itself, this needs the single-process scheduler
+                flags->single = 1;
+            }
+
+            else if(option_value(argv[i], "--format=") != NULL){
+                flags->format = output_format(option_value(argv[i], "--format=")); //Write records instead of drawing
+                if(flags->format == -1){
+                    printf("Wrong format of inputs, refer to readme\n");
+                    exit(1);
+                }
+            }
+            else if(strcmp(argv[i], "--disks") == 0){
+                flags->disks = 1; //Disk panel, sampled from the single-process scheduler
+                flags->single = 1;
+            }
+            else if(option_value(argv[i], "--disks=") != NULL){
+                flags->disks = 1;
+                flags->disk_filter = (char *)option_value(argv[i], "--disks=");
+                flags->single = 1;
+            }
+            else if(strcmp(argv[i], "--scroll") == 0){
+                flags->scroll = 1; //Unbounded, the graphs scroll once they are as wide as the terminal
+                flags->single = 1;
+            }
+            else if(option_value(argv[i], "--oversample=") != NULL){
+                flags->oversample = option_number(option_value(argv[i], "--oversample=")); //Samples per graph column
+                flags->single = 1;
+            }
+            else if(strcmp(argv[i], "--net") == 0){
+                flags->net = 1; //Network panel, sampled from the single-process scheduler
+                flags->single = 1;
+            }
+            else if(strcmp(argv[i], "--procs") == 0){
+                flags->procs = 10; //Top processes panel, scanned from the single-process scheduler
+                flags->single = 1;
+            }
+            else if(option_value(argv[i], "--procs=") != NULL){
+                flags->procs = option_number(option_value(argv[i], "--procs="));
+                flags->single = 1;
+            }
+            else if(option_value(argv[i], "--procs-sort=") != NULL){
+                const char *sort = option_value(argv[i], "--procs-sort=");
+                if(strcmp(sort, "cpu") == 0){
+                    flags->procs_sort = PROCS_BY_CPU;
+                }
+                else if(strcmp(sort, "rss") == 0){
+                    flags->procs_sort = PROCS_BY_RSS;
+                }
+                else{
+                    printf("Wrong format of inputs, refer to readme\n");
+                    exit(1);
+                }
+            }
+            else if(option_value(argv[i], "--procs-ms=") != NULL){
+                flags->procs_ms = option_number(option_value(argv[i], "--procs-ms="));
+            }
+            else if(option_value(argv[i], "--freq-ms=") != NULL){
+                flags->freq_ms = option_number(option_value(argv[i], "--freq-ms=")); //Per-core clocks at their own rate
+                flags->single = 1;
+            }
+            else if(option_value(argv[i], "--agent=") != NULL){
+                flags->agent = (char *)option_value(argv[i], "--agent="); //Stream samples to a collector
+            }
+            else if(option_value(argv[i], "--agent-name=") != NULL){
+                flags->agent_name = (char *)option_value(argv[i], "--agent-name=");
+            }
+            else if(option_value(argv[i], "--collector=") != NULL){
+                flags->collector = (char *)option_value(argv[i], "--collector="); //Show the agents that connect here
+            }
+            else if(strcmp(argv[i], "--psi") == 0){
+                flags->psi = 1; //Pressure stall panel with kernel triggers
+                flags->single = 1;
+            }
+            else if(option_value(argv[i], "--psi=") != NULL){
+                if(sscanf(option_value(argv[i], "--psi="), "%d/%d", &flags->psi_stall_ms, &flags->psi_window_ms) != 2
+                   || flags->psi_stall_ms <= 0 || flags->psi_window_ms < flags->psi_stall_ms){
+                    printf("Wrong format of inputs, refer to readme\n");
+                    exit(1);
+                }
+                flags->psi = 1;
+                flags->single = 1;
+            }
+            else if(strcmp(argv[i], "--kernel") == 0){
+                flags->kernel = 1; //Context switches, interrupts, faults and the run queue
+                flags->single = 1;
+            }
+            else if(strcmp(argv[i], "--adaptive") == 0){
+                flags->adaptive = 1; //Interval follows how fast CPU and memory change, bounds set in main
+                flags->single = 1;
+            }
+            else if(option_value(argv[i], "--adaptive=") != NULL){
+                int min_ms, max_ms;
+                if(sscanf(option_value(argv[i], "--adaptive="), "%d/%d", &min_ms, &max_ms) != 2 || min_ms <= 0 || max_ms < min_ms){
+                    printf("Wrong format of inputs, refer to readme\n");
+                    exit(1);
+                }
+                flags->adaptive = 1;
+                flags->adapt_min_us = min_ms * 1000L;
+                flags->adapt_max_us = max_ms * 1000L;
+                flags->single = 1;
+            }
+            else if(option_value(argv[i], "--cgroup=") != NULL){
+                flags->cgroup = (char *)option_value(argv[i], "--cgroup="); //One cgroup against its own limits
+                flags->cgroup_subtree = 0;
+                flags->single = 1;
+            }
+            else if(option_value(argv[i], "--cgroups-under=") != NULL){
+                flags->cgroup = (char *)option_value(argv[i], "--cgroups-under="); //The busiest cgroups of a subtree
+                flags->cgroup_subtree = 1;
+                flags->single = 1;
+            }
+            else if(option_value(argv[i], "--shm=") != NULL){
+                flags->shm = (char *)option_value(argv[i], "--shm="); //Publish every sample for local readers
+                flags->single = 1;
+            }
+            else if(option_value(argv[i], "--alert=") != NULL){
+                if(flags->nalerts == ALERT_MAX){
+                    printf("At most %d --alert rules\n", ALERT_MAX);
+                    exit(1);
+                }
+                flags->alerts[flags->nalerts++] = (char *)option_value(argv[i], "--alert="); //Checked once every flag is known
+                flags->single = 1;
+            }
+            else if(option_value(argv[i], "--alert-exec=") != NULL){
+                flags->alert_exec = (char *)option_value(argv[i], "--alert-exec=");
+            }
+            else if(option_value(argv[i], "--alert-fifo=") != NULL){
+                flags->alert_fifo = (char *)option_value(argv[i], "--alert-fifo=");
+            }
+            else if(option_value(argv[i], "--proc-root=") != NULL){
+                flags->proc_root = (char *)option_value(argv[i], "--proc-root="); //Sample a fixture instead of this machine
+            }
+            else if(option_value(argv[i], "--output=") != NULL){
+                flags->output = (char *)option_value(argv[i], "--output=");
+            }
+            else if(option_value(argv[i], "--flush-every=") != NULL){
+                flags->flush_every = option_number(option_value(argv[i], "--flush-every="));
+            }
+            else if(option_value(argv[i], "--flush-ms=") != NULL){
+                flags->flush_ms = option_number(option_value(argv[i], "--flush-ms="));
+            }
+            else if(option_value(argv[i], "--replay-speed=") != NULL){
+                char *end_ptr;
+                flags->replay_speed = strtof(option_value(argv[i], "--replay-speed="), &end_ptr);
+                if(*end_ptr != '\0' || flags->replay_speed < 0){
+                    printf("Wrong format of inputs, refer to readme\n");
+                    exit(1);
+                }
+            }
+
             else if(strcmp(argv[i], "--cores") == 0 && cores == 0){
                 if(flags->cores == 1){
                     flags->memory = 0;
@@ -497,7 +2396,7 @@ void process_flags(int argc, char ** argv, info *flags){
             else if(strncmp(argv[i], prefix, prefix_len) == 0 && s == 0){
                 const char *numberPart = argv[i] + prefix_len; //To get N from --samples=N
                 int num = (int)strtol(numberPart, &end_ptr, 10);
-                if(num != 0 && *end_ptr == '\0'){
+                if(num >= 0 && *numberPart != '\0' && *end_ptr == '\0'){ //0 means no limit, headless only
                     flags->samples = num;
                     s = 1;
                 }
@@ -531,6 +2430,13 @@ void process_flags(int argc, char ** argv, info *flags){
         }
 }
 
+// Removes the --shm segment, readers that still have it mapped keep the last sample
+void close_shm(){
+    if(shm.seg != NULL){
+        shm_close(&shm);
+    }
+}
+
 // Signal handler for Ctrl-C
 void handle_c(int signal) {
     char ans;
@@ -548,6 +2454,10 @@ void handle_c(int signal) {
     if (ans == 'y' || ans == 'Y') {
         clear_screen(); // Clear the screen
         reset_cursor(0); // Reset the cursor
+        if (self_stats.sched != NULL) {
+            selfstats_print(&self_stats, stdout); // Summary of the run so far
+        }
+        close_shm(); // Before the group's SIGTERM reaches this process too
         pid_t pgid = getpgrp();  // Get the current process group ID
         killpg(pgid, SIGTERM);   // Terminate all processes in the group
         exit(0);  // Terminate the program
@@ -573,6 +2483,45 @@ int main(int argc, char ** argv){
     flags.memory = 1;
     flags.cpu = 1;
     flags.cores = 1; //Setting the default values of memory, cpu and cores flags
+    flags.single = 0;
+    flags.frame_stats = 0;
+    flags.record = NULL;
+    flags.record_max = 64;
+    flags.replay = NULL;
+    flags.replay_speed = 1;
+    flags.mem_stack = 0;
+    flags.format = -1;
+    flags.output = NULL;
+    flags.flush_every = 100;
+    flags.flush_ms = 1000;
+    flags.self_stats = 0;
+    flags.proc_root = NULL;
+    flags.procs = 0;
+    flags.disks = 0;
+    flags.disk_filter = NULL;
+    flags.net = 0;
+    flags.scroll = 0;
+    flags.oversample = 1;
+    flags.freq_ms = 0;
+    flags.agent = NULL;
+    flags.agent_name = NULL;
+    flags.collector = NULL;
+    flags.psi = 0;
+    flags.nalerts = 0;
+    flags.alert_exec = NULL;
+    flags.alert_fifo = NULL;
+    flags.adaptive = 0;
+    flags.shm = NULL;
+    flags.cgroup = NULL;
+    flags.cgroup_subtree = 0;
+    flags.kernel = 0;
+    flags.braille = 0;
+    flags.adapt_min_us = 0;
+    flags.adapt_max_us = 0;
+    flags.psi_stall_ms = 150;
+    flags.psi_window_ms = 1000;
+    flags.procs_sort = PROCS_BY_CPU;
+    flags.procs_ms = 0;
 
     struct sigaction ctrlC, ctrlZ;
 
@@ -590,8 +2539,73 @@ int main(int argc, char ** argv){
         perror("Error setting signal handler for Ctrl-Z");
         exit(1);
     }
+    struct sigaction usr1;
+    memset(&usr1, 0, sizeof(usr1));
+    usr1.sa_handler = handle_usr1; //Print the self stats on demand
+    if(sigaction(SIGUSR1, &usr1, NULL) == -1){
+        perror("Error setting signal handler for SIGUSR1");
+        exit(1);
+    }
     process_flags(argc, argv, &flags); //Function to process the flags and update values of samples, tdelay and memory, cpu and cores flags
-    
-    show(flags);
+    sampler_set_root(flags.proc_root);
+    if(flags.adaptive && flags.adapt_max_us == 0){
+        flags.adapt_min_us = flags.tdelay / 4 > 0 ? flags.tdelay / 4 : 1; //Four times faster to four times slower than --tdelay
+        flags.adapt_max_us = flags.tdelay * 4L;
+    }
+    long tick = flags.adaptive ? flags.adapt_min_us : flags.tdelay / (flags.oversample > 1 ? flags.oversample : 1);
+    for(int i = 0; i < flags.nalerts; i++){
+        if(alert_add(&alerts, flags.alerts[i], tick) == -1){
+            exit(1);
+        }
+    }
+    alerts.exec = flags.alert_exec;
+    alerts.fifo = flags.alert_fifo;
+    alerts.fifo_fd = -1;
+    if(flags.alert_fifo != NULL){
+        signal(SIGPIPE, SIG_IGN); //A FIFO reader that goes away is not a reason to exit
+    }
+
+    if(flags.shm != NULL && flags.replay == NULL && flags.collector == NULL){
+        if(shm_create(&shm, flags.shm, cpu_count()) == -1){
+            exit(1);
+        }
+        atexit(close_shm); //Ctrl-C and the end of the run both leave through exit
+    }
 
+    if(flags.agent != NULL && flags.format == -1){
+        flags.samples = 0; //An agent streams until it is stopped
+    }
+    if(flags.format != -1 || flags.agent != NULL || flags.collector != NULL){
+        struct sigaction stop;
+        memset(&stop, 0, sizeof(stop));
+        stop.sa_handler = handle_stop; //No prompt without a screen, just finish the last batch and exit
+        sigaction(SIGINT, &stop, NULL);
+        sigaction(SIGTERM, &stop, NULL);
+        signal(SIGPIPE, SIG_IGN);
+        if(flags.collector != NULL){
+            if(flags.format == -1){
+                sigaction(SIGINT, &ctrlC, NULL); //The collector draws, so Ctrl-C asks first like the graphs do
+            }
+            run_collector(flags);
+        }
+        else{
+            run_headless(flags);
+        }
+        return 0;
+    }
+    if(flags.scroll && flags.replay == NULL){
+        flags.samples = terminal_cols() - offset - 2; //The width of the graphs, the history they keep
+        if(flags.braille){
+            flags.samples *= 2; //Two columns per cell
+        }
+        if(flags.samples < 10){
+            flags.samples = 10;
+        }
+    }
+    if(flags.samples == 0){
+        printf("--samples=0 only works with --format, refer to readme\n");
+        exit(1);
+    }
+    show(flags);
+    return 0;
 }
\ No newline at end of file
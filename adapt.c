@@ -0,0 +1,59 @@
+#include <string.h>
+#include <unistd.h>
+#include "adapt.h"
+
+void adapt_init(Adaptive *a, long min_us, long max_us, long start_us, float mem_total, int ncpus) {
+    memset(a, 0, sizeof(*a));
+    a->min_ns = min_us * 1000LL;
+    a->max_ns = max_us * 1000LL;
+    a->period_ns = start_us * 1000LL;
+    if (a->period_ns < a->min_ns) {
+        a->period_ns = a->min_ns;
+    }
+    if (a->period_ns > a->max_ns) {
+        a->period_ns = a->max_ns;
+    }
+    a->mem_total = mem_total;
+    a->cpu_ticks = (float)sysconf(_SC_CLK_TCK) * (ncpus > 0 ? ncpus : 1);
+}
+
+// Takes the newest sample and returns the interval to sample at next. The change is the larger
+// of the CPU and memory ones, in % points, so both series count the same. CPU utilization only
+// moves in steps of one clock tick per interval, so changes up to a step are noise: without
+// that, short intervals would look busy on their own and never grow back
+long long adapt_update(Adaptive *a, const Sample *s) {
+    float mem = a->mem_total > 0 ? s->mem_used / a->mem_total * 100 : 0;
+    if (!a->primed) {
+        a->prev_cpu = s->cpu;
+        a->prev_mem = mem;
+        a->primed = 1;
+        return a->period_ns;
+    }
+    float step = 100 / (a->cpu_ticks * (a->period_ns / 1e9f)); //% one tick is worth at this interval
+    float d_cpu = s->cpu > a->prev_cpu ? s->cpu - a->prev_cpu : a->prev_cpu - s->cpu;
+    d_cpu = d_cpu > step ? d_cpu - step : 0;
+    float d_mem = mem - a->prev_mem;
+    float d = d_cpu * d_cpu > d_mem * d_mem ? d_cpu * d_cpu : d_mem * d_mem;
+    a->prev_cpu = s->cpu;
+    a->prev_mem = mem;
+    a->var += ADAPT_WEIGHT * (d - a->var);
+
+    long long period = a->period_ns;
+    if (a->var > ADAPT_BUSY * ADAPT_BUSY) {
+        period /= 2; //Catch the burst right away
+    }
+    else if (a->var < ADAPT_CALM * ADAPT_CALM) {
+        period += period / 4; //Back off slowly, a burst may come back
+    }
+    if (period < a->min_ns) {
+        period = a->min_ns;
+    }
+    if (period > a->max_ns) {
+        period = a->max_ns;
+    }
+    if (period != a->period_ns) {
+        a->period_ns = period;
+        a->changes++;
+    }
+    return period;
+}
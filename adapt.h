@@ -0,0 +1,27 @@
+#ifndef ADAPT_H
+#define ADAPT_H
+
+#include "sample.h"
+
+#define ADAPT_BUSY 8.0f   // % points of change per sample above which the interval halves
+#define ADAPT_CALM 2.0f   // and below which it grows back by a quarter
+#define ADAPT_WEIGHT 0.3f // of the newest change in the running variance
+
+// Picks the next sampling interval from how much CPU and memory moved lately. The interval
+// halves as soon as the series get busy and grows back slowly once they are calm, always
+// between min_ns and max_ns
+typedef struct {
+    long long min_ns, max_ns;
+    long long period_ns;  // the interval to sample at next
+    float mem_total;      // GB, memory changes are compared as % of it
+    float cpu_ticks;      // clock ticks per second over every cpu, what /proc/stat counts in
+    float prev_cpu, prev_mem;
+    float var;            // running mean of the squared change, in % points squared
+    int primed;           // 0 until there is a previous sample to compare with
+    unsigned long changes; // times the interval changed
+} Adaptive;
+
+void adapt_init(Adaptive *a, long min_us, long max_us, long start_us, float mem_total, int ncpus);
+long long adapt_update(Adaptive *a, const Sample *s);
+
+#endif
@@ -0,0 +1,419 @@
+#define _GNU_SOURCE // accept4
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "agent.h"
+
+#define AGENT_RETRY_NS 1000000000LL // between reconnects, and how long a send may block
+#define AGENT_RECORD_MAX 65536      // larger records in a hello are refused
+#define AGENT_HELLO_NS 5000000000LL // a connection that has not sent its hello by then is dropped
+
+// Resolves "unix:PATH", a path with a '/', "HOST:PORT" or ":PORT" (every address when listening,
+// localhost when connecting). Returns the socket family, -1 when addr cannot be resolved
+static int agent_addr(const char *addr, int passive, struct sockaddr_storage *ss, socklen_t *len) {
+    memset(ss, 0, sizeof(*ss));
+    const char *path = strncmp(addr, "unix:", 5) == 0 ? addr + 5 : strchr(addr, '/') != NULL ? addr : NULL;
+    if (path != NULL) {
+        struct sockaddr_un *un = (struct sockaddr_un *)ss;
+        if (strlen(path) >= sizeof(un->sun_path)) {
+            fprintf(stderr, "socket path too long: %s\n", path);
+            return -1;
+        }
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, path);
+        *len = sizeof(*un);
+        return AF_UNIX;
+    }
+
+    const char *colon = strrchr(addr, ':');
+    if (colon == NULL) {
+        fprintf(stderr, "expected unix:PATH or HOST:PORT, got %s\n", addr);
+        return -1;
+    }
+    char host[256];
+    size_t hlen = colon - addr;
+    if (hlen >= sizeof(host)) {
+        hlen = sizeof(host) - 1;
+    }
+    memcpy(host, addr, hlen);
+    host[hlen] = '\0';
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    int err = getaddrinfo(hlen > 0 ? host : NULL, colon + 1, &hints, &res);
+    if (err != 0) {
+        fprintf(stderr, "unable to resolve %s: %s\n", addr, gai_strerror(err));
+        return -1;
+    }
+    memcpy(ss, res->ai_addr, res->ai_addrlen);
+    *len = res->ai_addrlen;
+    int family = res->ai_family;
+    freeaddrinfo(res);
+    return family;
+}
+
+static int send_full(int fd, const void *buf, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = send(fd, (const char *)buf + done, len - done, MSG_NOSIGNAL);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        done += n;
+    }
+    return 0;
+}
+
+int agent_open(Agent *a, const char *addr, const char *name, int ncores) {
+    memset(a, 0, sizeof(*a));
+    a->addr = addr;
+    a->fd = -1;
+    HistoryHeader *hdr = &a->hello.hdr;
+    memcpy(hdr->magic, AGENT_MAGIC, 8);
+    hdr->version = HISTORY_VERSION;
+    hdr->head_size = SAMPLE_HEAD_SIZE;
+    hdr->ncores = ncores;
+    hdr->record_size = history_record_size(ncores);
+    snprintf(a->hello.name, sizeof(a->hello.name), "%s", name);
+    a->rec = malloc(hdr->record_size);
+    if (a->rec == NULL) {
+        perror("malloc error, unable to allocate the agent record");
+        return -1;
+    }
+    struct sockaddr_storage ss;
+    socklen_t len;
+    return agent_addr(addr, 0, &ss, &len) == -1 ? -1 : 0; //Only checks the address, connecting waits for the first sample
+}
+
+// Connects and sends the hello. Sends and the connect itself give up after AGENT_RETRY_NS,
+// so a stuck collector costs at most one tick
+static int agent_connect(Agent *a) {
+    long long now = now_ns();
+    if (now < a->retry_ns) {
+        return -1;
+    }
+    a->retry_ns = now + AGENT_RETRY_NS;
+    struct sockaddr_storage ss;
+    socklen_t len;
+    int family = agent_addr(a->addr, 0, &ss, &len);
+    if (family == -1) {
+        return -1;
+    }
+    a->fd = socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (a->fd == -1) {
+        perror("socket error");
+        return -1;
+    }
+    struct timeval timeout = { AGENT_RETRY_NS / 1000000000LL, 0 };
+    setsockopt(a->fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (family != AF_UNIX) {
+        int one = 1;
+        setsockopt(a->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); //One small record per tick, send it now
+    }
+    if (connect(a->fd, (struct sockaddr *)&ss, len) == -1 || send_full(a->fd, &a->hello, sizeof(a->hello)) == -1) {
+        close(a->fd);
+        a->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+// Sends one record, -1 when it was dropped because the collector is not there
+int agent_send(Agent *a, const Sample *s) {
+    if (a->fd == -1 && agent_connect(a) == -1) {
+        a->dropped++;
+        return -1;
+    }
+    uint32_t size = a->hello.hdr.record_size;
+    history_pack(a->rec, s, a->hello.hdr.ncores, size);
+    if (send_full(a->fd, a->rec, size) == -1) {
+        close(a->fd); //A partial record cannot be taken back, start over with a new hello
+        a->fd = -1;
+        a->dropped++;
+        return -1;
+    }
+    a->sent++;
+    return 0;
+}
+
+void agent_close(Agent *a) {
+    if (a->fd != -1) {
+        close(a->fd);
+    }
+    free(a->rec);
+    a->fd = -1;
+    a->rec = NULL;
+}
+
+// The connection went away, the row stays with its last values
+static void peer_gone(Peer *p) {
+    sched_unwatch(p->fleet->sched, &p->watch);
+    close(p->fd);
+    p->fd = -1;
+    p->greeted = 0;
+    p->len = 0;
+    p->since_ns = now_ns();
+}
+
+// Forgets a connection that never said a valid hello, or a row that is given to another agent.
+// Its row is free at once, but the Peer itself is only freed by the next fleet_expire: an
+// epoll event for it may still be waiting later in the batch that is being handled
+static void peer_drop(Peer *p) {
+    Fleet *f = p->fleet;
+    if (p->fd != -1) {
+        sched_unwatch(f->sched, &p->watch);
+        close(p->fd);
+        p->fd = -1; //peer_read returns at once when it still runs for this batch
+    }
+    for (int i = 0; i < f->n; i++) {
+        if (f->peer[i] == p) {
+            memmove(&f->peer[i], &f->peer[i + 1], (f->n - i - 1) * sizeof(Peer *)); //Rows keep their order on screen
+            f->n--;
+            break;
+        }
+    }
+    p->next = f->dropped;
+    f->dropped = p;
+}
+
+static void peer_free(Peer *p) {
+    free(p->buf);
+    free(p);
+}
+
+// Frees the peers dropped since the last call, none of them can have an event pending anymore
+static void fleet_reap(Fleet *f) {
+    while (f->dropped != NULL) {
+        Peer *p = f->dropped;
+        f->dropped = p->next;
+        peer_free(p);
+    }
+}
+
+// Checks the hello and sizes the buffer for records. An agent that comes back under the same
+// name takes over its old row, then 1 is returned and p is gone
+static int peer_greet(Peer *p) {
+    HistoryHeader *hdr = &p->hello.hdr;
+    if (memcmp(hdr->magic, AGENT_MAGIC, 8) != 0 || hdr->version != HISTORY_VERSION
+        || hdr->head_size < sizeof(long long) || hdr->record_size > AGENT_RECORD_MAX
+        || hdr->record_size < hdr->head_size + (uint64_t)hdr->ncores * sizeof(float)) {
+        return -1; //Not an agent, or one this build cannot read
+    }
+    p->hello.name[AGENT_NAME - 1] = '\0';
+    for (char *c = p->hello.name; *c != '\0'; c++) {
+        if (*c < ' ' || *c == '"' || *c == '\\' || *c == ',') {
+            *c = '_'; //The name is printed as is in CSV and JSON records
+        }
+    }
+    char *bigger = realloc(p->buf, hdr->record_size);
+    if (bigger == NULL) {
+        perror("realloc error, unable to allocate an agent buffer");
+        return -1;
+    }
+    p->buf = bigger;
+    p->need = hdr->record_size;
+    p->greeted = 1;
+
+    Fleet *f = p->fleet;
+    for (int i = 0; i < f->n; i++) {
+        Peer *old = f->peer[i];
+        if (old != p && old->fd == -1 && strcmp(old->hello.name, p->hello.name) == 0) {
+            sched_unwatch(f->sched, &p->watch);
+            old->fd = p->fd;
+            old->hello = p->hello;
+            old->greeted = 1;
+            free(old->buf);
+            old->buf = p->buf;
+            old->len = 0;
+            old->need = p->need;
+            old->watch.fd = old->fd;
+            p->fd = -1; //Both now belong to the old row
+            p->buf = NULL;
+            peer_drop(p);
+            if (sched_watch(f->sched, &old->watch, EPOLLIN) == -1) {
+                peer_gone(old);
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Reads whatever the agent sent, a record at a time, until the socket would block
+static void peer_read(void *ctx, uint32_t events) {
+    Peer *p = ctx;
+    while (p->fd != -1) {
+        ssize_t n = read(p->fd, p->buf + p->len, p->need - p->len);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1 && errno == EAGAIN) {
+            return;
+        }
+        if (n <= 0) {
+            if (p->greeted) {
+                peer_gone(p);
+            }
+            else {
+                peer_drop(p);
+            }
+            return;
+        }
+        p->len += n;
+        if (p->len < p->need) {
+            continue;
+        }
+        p->len = 0;
+        if (!p->greeted) {
+            memcpy(&p->hello, p->buf, sizeof(p->hello));
+            int greeted = peer_greet(p);
+            if (greeted == -1) {
+                peer_drop(p);
+            }
+            if (greeted != 0) {
+                return; //p is gone, or merged into an older row that is watched now
+            }
+            continue;
+        }
+        history_unpack(&p->last, p->buf, &p->hello.hdr);
+        p->history[p->frames % AGENT_HISTORY] = p->last.cpu;
+        p->frames++;
+        p->last_ns = now_ns();
+        if (p->fleet->on_sample != NULL) {
+            p->fleet->on_sample(p->fleet->ctx, p);
+        }
+    }
+}
+
+// Makes room for one more agent by dropping the row that has been gone the longest.
+// Returns -1 when every row is still connected
+static int fleet_evict(Fleet *f) {
+    Peer *oldest = NULL;
+    for (int i = 0; i < f->n; i++) {
+        Peer *p = f->peer[i];
+        if (p->fd == -1 && (oldest == NULL || p->since_ns < oldest->since_ns)) {
+            oldest = p;
+        }
+    }
+    if (oldest == NULL) {
+        return -1;
+    }
+    peer_drop(oldest);
+    return 0;
+}
+
+// Drops the connections that did not send a hello in time, so they cannot hold rows forever.
+// A collector, so it runs after the scheduler handled every epoll event of its wakeup
+static void fleet_expire(void *ctx, long long ts_ns) {
+    Fleet *f = ctx;
+    fleet_reap(f);
+    for (int i = f->n - 1; i >= 0; i--) { //peer_drop moves the rows after i
+        Peer *p = f->peer[i];
+        if (p->fd != -1 && !p->greeted && ts_ns - p->since_ns > AGENT_HELLO_NS) {
+            peer_drop(p);
+        }
+    }
+}
+
+static void fleet_accept(void *ctx, uint32_t events) {
+    Fleet *f = ctx;
+    for (;;) {
+        int fd = accept4(f->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno != EAGAIN && errno != EINTR) {
+                perror("accept error");
+            }
+            if (errno != EINTR) {
+                return;
+            }
+            continue;
+        }
+        Peer *p = f->n < AGENT_PEERS || fleet_evict(f) == 0 ? calloc(1, sizeof(Peer)) : NULL;
+        if (p != NULL) {
+            p->buf = malloc(sizeof(AgentHello));
+        }
+        if (p == NULL || p->buf == NULL) {
+            if (p != NULL) {
+                free(p);
+            }
+            close(fd); //Every row is taken
+            continue;
+        }
+        p->fd = fd;
+        p->since_ns = now_ns();
+        p->fleet = f;
+        p->need = sizeof(AgentHello);
+        p->watch.fd = fd;
+        p->watch.fn = peer_read;
+        p->watch.ctx = p;
+        if (sched_watch(f->sched, &p->watch, EPOLLIN) == -1) {
+            close(fd);
+            free(p->buf);
+            free(p);
+            continue;
+        }
+        f->peer[f->n++] = p;
+    }
+}
+
+int fleet_open(Fleet *f, const char *addr, Scheduler *sched) {
+    memset(f, 0, sizeof(*f));
+    f->sched = sched;
+    struct sockaddr_storage ss;
+    socklen_t len;
+    int family = agent_addr(addr, 1, &ss, &len);
+    if (family == -1) {
+        return -1;
+    }
+    f->fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (f->fd == -1) {
+        perror("socket error");
+        return -1;
+    }
+    if (family == AF_UNIX) {
+        memcpy(f->path, ((struct sockaddr_un *)&ss)->sun_path, sizeof(f->path)); //Both are sun_path sized
+        unlink(f->path); //Left behind by a collector that did not exit cleanly
+    }
+    else {
+        int one = 1;
+        setsockopt(f->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    if (bind(f->fd, (struct sockaddr *)&ss, len) == -1 || listen(f->fd, AGENT_PEERS) == -1) {
+        perror("unable to listen for agents");
+        close(f->fd);
+        return -1;
+    }
+    f->watch.fd = f->fd;
+    f->watch.fn = fleet_accept;
+    f->watch.ctx = f;
+    sched_add(sched, "hellos", AGENT_HELLO_NS / 1000, fleet_expire, f);
+    return sched_watch(sched, &f->watch, EPOLLIN);
+}
+
+void fleet_close(Fleet *f) {
+    for (int i = 0; i < f->n; i++) {
+        if (f->peer[i]->fd != -1) {
+            close(f->peer[i]->fd);
+        }
+        peer_free(f->peer[i]);
+    }
+    f->n = 0;
+    fleet_reap(f);
+    close(f->fd);
+    if (f->path[0] != '\0') {
+        unlink(f->path);
+    }
+}
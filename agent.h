@@ -0,0 +1,73 @@
+#ifndef AGENT_H
+#define AGENT_H
+
+#include <stdint.h>
+#include "history.h"
+#include "sched.h"
+
+// An agent's stream starts with an AgentHello, a HistoryHeader carrying this magic and
+// capacity 0 followed by the agent's name, then one record per tick laid out like --record's.
+// A collector reads any head_size and ncores the header announces, like replay does
+#define AGENT_MAGIC "SYSMONA1"
+#define AGENT_NAME 64
+#define AGENT_PEERS 64   // most agents a collector shows at once
+#define AGENT_HISTORY 40 // CPU values kept per agent for its history column
+#define AGENT_PATH 108   // sun_path of a unix socket address
+
+typedef struct {
+    HistoryHeader hdr;
+    char name[AGENT_NAME];
+} AgentHello;
+
+// Sending side. The connection is made lazily and remade at most once a second when the
+// collector is away, samples taken in the meantime are dropped
+typedef struct {
+    const char *addr;
+    int fd;
+    AgentHello hello;
+    char *rec; // one packed record
+    long long retry_ns; // no reconnect before this
+    unsigned long sent, dropped;
+} Agent;
+
+// One connected (or gone) agent as the collector sees it
+typedef struct Peer {
+    int fd; // -1 once it disconnected, the row stays until the same name connects again or
+            // the table is full and it is the row that has been gone the longest
+    Watch watch;
+    struct Fleet *fleet;
+    AgentHello hello;
+    int greeted; // the hello has been read, records follow
+    char *buf;
+    size_t len, need;
+    Sample last;
+    float history[AGENT_HISTORY]; // ring of the latest CPU values
+    unsigned long frames;
+    long long last_ns; // CLOCK_MONOTONIC when the last record arrived
+    long long since_ns; // when it connected, or when it went away once fd is -1
+    struct Peer *next;  // in Fleet.dropped
+} Peer;
+
+typedef void (*peer_fn)(void *ctx, Peer *p);
+
+// Listening side, the listening socket and every agent are watched by the caller's scheduler
+typedef struct Fleet {
+    int fd;
+    char path[AGENT_PATH]; // unix socket removed on close, "" for TCP
+    Watch watch;
+    Scheduler *sched;
+    Peer *peer[AGENT_PEERS];
+    int n;
+    Peer *dropped; // out of peer[] but not freed yet, see peer_drop
+    peer_fn on_sample; // called for every record received, NULL when only the latest is kept
+    void *ctx;
+} Fleet;
+
+int agent_open(Agent *a, const char *addr, const char *name, int ncores);
+int agent_send(Agent *a, const Sample *s);
+void agent_close(Agent *a);
+
+int fleet_open(Fleet *f, const char *addr, Scheduler *sched);
+void fleet_close(Fleet *f);
+
+#endif
@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include "alert.h"
+#include "sched.h"
+
+// Series a rule can watch, in GB except cpu
+static const struct {
+    const char *name;
+    size_t off;
+} series[] = {
+    { "cpu", offsetof(Sample, cpu) },
+    { "mem_used", offsetof(Sample, mem_used) },
+    { "mem_available", offsetof(Sample, mem_available) },
+    { "mem_cached", offsetof(Sample, mem_cached) },
+    { "mem_buffers", offsetof(Sample, mem_buffers) },
+    { "mem_dirty", offsetof(Sample, mem_dirty) },
+    { "mem_shmem", offsetof(Sample, mem_shmem) },
+    { "swap_used", offsetof(Sample, swap_used) },
+};
+
+#define SERIES (sizeof(series) / sizeof(series[0]))
+
+static const char *skip_blanks(const char *p) {
+    while (*p == ' ') {
+        p++;
+    }
+    return p;
+}
+
+// "5s", "500ms", "2m", -1 when p is not a duration
+static long long parse_duration(const char **p) {
+    char *end;
+    double v = strtod(*p, &end);
+    if (end == *p) {
+        return -1;
+    }
+    double scale = 1e9;
+    if (strncmp(end, "ms", 2) == 0) {
+        scale = 1e6;
+        end += 2;
+    }
+    else if (*end == 's') {
+        end++;
+    }
+    else if (*end == 'm') {
+        scale = 60e9;
+        end++;
+    }
+    *p = end;
+    return (long long)(v * scale);
+}
+
+// A number with an optional unit: "90", "90%", "2GB", "500MB", rates may end in "/s"
+static int parse_value(const char **p, float *v) {
+    char *end;
+    *v = strtof(*p, &end);
+    if (end == *p) {
+        return -1;
+    }
+    if (strncmp(end, "GB", 2) == 0) {
+        end += 2;
+    }
+    else if (strncmp(end, "MB", 2) == 0) {
+        *v /= 1024; //Series are in GB
+        end += 2;
+    }
+    else if (*end == '%') {
+        end++;
+    }
+    if (strncmp(end, "/s", 2) == 0) {
+        end += 2;
+    }
+    *p = end;
+    return 0;
+}
+
+static int parse_series(const char **p, size_t *off) {
+    const char *name = *p;
+    size_t len = 0;
+    while (isalnum((unsigned char)name[len]) || name[len] == '_') {
+        len++;
+    }
+    for (size_t i = 0; i < SERIES; i++) {
+        if (strlen(series[i].name) == len && strncmp(series[i].name, name, len) == 0) {
+            *off = series[i].off;
+            *p = name + len;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Parses text into a new rule, tick_us sizes the window of rate rules
+int alert_add(Alerts *a, const char *text, long tick_us) {
+    if (a->n == ALERT_MAX) {
+        fprintf(stderr, "at most %d alert rules\n", ALERT_MAX);
+        return -1;
+    }
+    AlertRule *r = &a->rule[a->n];
+    memset(r, 0, sizeof(*r));
+    snprintf(r->text, sizeof(r->text), "%s", text);
+    long long window = ALERT_RATE_WINDOW;
+    const char *p = skip_blanks(text);
+    if (strncmp(p, "d/dt(", 5) == 0) {
+        r->rate = 1;
+        p = skip_blanks(p + 5);
+    }
+    if (parse_series(&p, &r->off) == -1) {
+        goto bad;
+    }
+    if (r->rate) {
+        p = skip_blanks(p);
+        if (*p == ',') {
+            p = skip_blanks(p + 1);
+            window = parse_duration(&p);
+            if (window <= 0) {
+                goto bad;
+            }
+            p = skip_blanks(p);
+        }
+        if (*p++ != ')') {
+            goto bad;
+        }
+    }
+    p = skip_blanks(p);
+    if (*p != '>' && *p != '<') {
+        goto bad;
+    }
+    r->below = *p++ == '<';
+    p = skip_blanks(p);
+    if (parse_value(&p, &r->threshold) == -1) {
+        goto bad;
+    }
+    float margin = r->threshold != 0 ? r->threshold * 0.05f : 0.05f; //Default hysteresis: 5% of the threshold
+    if (margin < 0) {
+        margin = -margin;
+    }
+    r->clear = r->below ? r->threshold + margin : r->threshold - margin;
+    for (;;) {
+        p = skip_blanks(p);
+        if (strncmp(p, "for ", 4) == 0) {
+            p = skip_blanks(p + 4);
+            r->for_ns = parse_duration(&p);
+            if (r->for_ns < 0) {
+                goto bad;
+            }
+        }
+        else if (strncmp(p, "clear ", 6) == 0) {
+            p = skip_blanks(p + 6);
+            if (parse_value(&p, &r->clear) == -1 || (r->below ? r->clear < r->threshold : r->clear > r->threshold)) {
+                goto bad;
+            }
+        }
+        else if (*p == '\0') {
+            break;
+        }
+        else {
+            goto bad;
+        }
+    }
+
+    if (r->rate) {
+        long long tick = tick_us > 0 ? tick_us * 1000LL : 1000000000LL;
+        r->ring_cap = window / tick + 1; //Enough samples to span the window
+        if (r->ring_cap < 2) {
+            r->ring_cap = 2;
+        }
+        if (r->ring_cap > ALERT_RING_MAX) {
+            r->ring_cap = ALERT_RING_MAX;
+        }
+        r->ring = malloc(r->ring_cap * sizeof(float));
+        r->ring_ns = malloc(r->ring_cap * sizeof(long long));
+        if (r->ring == NULL || r->ring_ns == NULL) {
+            perror("malloc error, unable to allocate an alert window");
+            free(r->ring);
+            free(r->ring_ns);
+            return -1;
+        }
+    }
+    a->n++;
+    return 0;
+
+bad:
+    fprintf(stderr, "unable to parse alert rule \"%s\", expected e.g. \"cpu > 90 for 5s\", \"mem_available < 2GB\" "
+            "or \"d/dt(mem_used, 10s) > 500MB clear 100MB\"\n", text);
+    return -1;
+}
+
+// Runs the hook with the transition in its environment. Its output is discarded, whatever
+// draws or writes records on stdout keeps it to itself
+static void run_hook(Alerts *a, AlertRule *r, const char *state) {
+    if (r->hook > 0) {
+        r->skipped++; //One command per rule at a time, a stuck hook does not pile up
+        return;
+    }
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork error, unable to run the alert hook");
+        return;
+    }
+    if (pid == 0) {
+        char value[32];
+        snprintf(value, sizeof(value), "%.2f", r->value);
+        setenv("SYSMON_RULE", r->text, 1);
+        setenv("SYSMON_STATE", state, 1);
+        setenv("SYSMON_VALUE", value, 1);
+        int null = open("/dev/null", O_RDWR);
+        if (null != -1) {
+            dup2(null, STDIN_FILENO);
+            dup2(null, STDOUT_FILENO);
+            dup2(null, STDERR_FILENO);
+        }
+        signal(SIGPIPE, SIG_DFL); //Headless mode ignores it, the hook should not
+        signal(SIGINT, SIG_IGN); //Ctrl-C asks the monitor, not its hooks
+        execl("/bin/sh", "sh", "-c", a->exec, (char *)NULL);
+        _exit(127);
+    }
+    r->hook = pid;
+}
+
+// One line per transition. The FIFO is opened without blocking and kept open while someone
+// reads it, so a FIFO nobody reads costs a failed open instead of a stalled tick. SIGPIPE has
+// to be ignored for a reader that goes away
+static void write_fifo(Alerts *a, AlertRule *r, const char *state) {
+    char line[ALERT_TEXT + 64];
+    int len = snprintf(line, sizeof(line), "%lld %s %.2f %s\n", wall_ns(), state, r->value, r->text);
+    if (len >= (int)sizeof(line)) {
+        len = sizeof(line) - 1;
+    }
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (a->fifo_fd == -1) {
+            a->fifo_fd = open(a->fifo, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+            if (a->fifo_fd == -1) {
+                break; //Nobody is reading
+            }
+        }
+        if (write(a->fifo_fd, line, len) == len) { //Shorter than PIPE_BUF, so all or nothing
+            return;
+        }
+        if (errno != EPIPE) {
+            break; //Full, the reader is behind
+        }
+        close(a->fifo_fd); //The reader went away, a new one may be waiting
+        a->fifo_fd = -1;
+    }
+    a->fifo_dropped++;
+}
+
+static void transition(Alerts *a, AlertRule *r, const char *state) {
+    if (a->exec != NULL) {
+        run_hook(a, r, state);
+    }
+    if (a->fifo != NULL) {
+        write_fifo(a, r, state);
+    }
+}
+
+// The change per second over the rule's window
+static float rate_of(AlertRule *r, float v, long long ts_ns) {
+    r->ring[r->ring_head] = v;
+    r->ring_ns[r->ring_head] = ts_ns;
+    r->ring_head = (r->ring_head + 1) % r->ring_cap;
+    if (r->ring_n < r->ring_cap) {
+        r->ring_n++;
+    }
+    int oldest = (r->ring_head - r->ring_n + r->ring_cap) % r->ring_cap;
+    long long dt = ts_ns - r->ring_ns[oldest];
+    return dt > 0 ? (v - r->ring[oldest]) / (dt / 1e9) : 0;
+}
+
+// Evaluates every rule against one sample, ts_ns is the CLOCK_MONOTONIC time it was taken at
+void alert_eval(Alerts *a, const Sample *s, long long ts_ns) {
+    for (int i = 0; i < a->n; i++) {
+        AlertRule *r = &a->rule[i];
+        float v = *(const float *)((const char *)s + r->off);
+        if (r->rate) {
+            v = rate_of(r, v, ts_ns);
+            if (r->ring_n < 2) {
+                continue; //No change to measure yet
+            }
+        }
+        r->value = v;
+        int over = r->below ? v < r->threshold : v > r->threshold;
+        int back = r->below ? v > r->clear : v < r->clear;
+        if (!r->firing) {
+            if (!over) {
+                r->since_ns = 0;
+                continue;
+            }
+            if (r->since_ns == 0) {
+                r->since_ns = ts_ns;
+            }
+            if (ts_ns - r->since_ns >= r->for_ns) {
+                r->firing = 1;
+                r->fired++;
+                transition(a, r, "firing");
+            }
+        }
+        else if (back) {
+            r->firing = 0;
+            r->since_ns = 0;
+            transition(a, r, "resolved");
+        }
+    }
+}
+
+// Collects the hooks that exited, never blocks
+void alert_reap(Alerts *a) {
+    for (int i = 0; i < a->n; i++) {
+        AlertRule *r = &a->rule[i];
+        if (r->hook > 0 && waitpid(r->hook, NULL, WNOHANG) != 0) {
+            r->hook = 0; //Exited, or already reaped by someone else
+        }
+    }
+}
+
+void alert_free(Alerts *a) {
+    if (a->fifo_fd != -1) {
+        close(a->fifo_fd);
+        a->fifo_fd = -1;
+    }
+    for (int i = 0; i < a->n; i++) {
+        free(a->rule[i].ring);
+        free(a->rule[i].ring_ns);
+    }
+    a->n = 0;
+}
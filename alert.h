@@ -0,0 +1,51 @@
+#ifndef ALERT_H
+#define ALERT_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "sample.h"
+
+#define ALERT_MAX 16
+#define ALERT_TEXT 128
+#define ALERT_RATE_WINDOW 5000000000LL // ns a d/dt() rule looks back by default
+#define ALERT_RING_MAX 4096            // most samples a d/dt() window keeps
+
+// One rule, e.g. "cpu > 90 for 5s", "mem_available < 2GB" or "d/dt(mem_used, 10s) > 500MB".
+// It fires once the condition has held for for_ns and resolves when the value crosses back
+// past clear, so a value hovering around the threshold does not flap
+typedef struct {
+    char text[ALERT_TEXT];
+    size_t off;            // the series, a float in Sample
+    int rate;              // 1 compares the change per second over the window instead
+    int below;             // 1 for '<'
+    float threshold;
+    float clear;
+    long long for_ns;
+    float *ring;           // values of the last window, rate rules only
+    long long *ring_ns;
+    int ring_cap, ring_n, ring_head;
+    long long since_ns;    // when the condition started holding, 0 while it does not
+    int firing;
+    float value;           // what was compared on the last tick
+    unsigned long fired;
+    pid_t hook;            // the command started by the last transition, 0 once it exited
+    unsigned long skipped; // transitions whose command was not started, the previous one was still running
+} AlertRule;
+
+// Every rule and where their transitions go. Evaluating costs O(1) per rule and tick,
+// commands run in the background and are reaped without blocking
+typedef struct {
+    AlertRule rule[ALERT_MAX];
+    int n;
+    const char *exec;      // run with sh -c on every transition, NULL for none
+    const char *fifo;      // a line per transition, dropped while nobody reads it. NULL for none
+    int fifo_fd;           // -1 until a reader is there
+    unsigned long fifo_dropped;
+} Alerts;
+
+int alert_add(Alerts *a, const char *text, long tick_us);
+void alert_eval(Alerts *a, const Sample *s, long long ts_ns);
+void alert_reap(Alerts *a);
+void alert_free(Alerts *a);
+
+#endif
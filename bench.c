@@ -0,0 +1,775 @@
+// Microbenchmarks of the per-tick collectors and the renderer against synthetic /proc and /sys trees.
+// Built from A3.c itself so the plotting functions are the ones the monitor runs, see `make bench`
+#define main a3_main
+#include "A3.c"
+#undef main
+
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#define BENCH_MIN_NS 50000000LL // every benchmark runs for at least this long
+#define BENCH_COLS 100          // width of the plotted graphs, like --samples=100
+#define FIXTURE_VERSION 9       // bump when the generated files change, older fixtures are regenerated
+
+typedef struct {
+    const char *name;
+    int cpus;
+    int sockets;
+    int procs; // entries in the process table
+    int disks; // lines in /proc/diskstats
+} Host;
+
+static const Host hosts[] = {
+    { "1cpu", 1, 1, 120, 12 },
+    { "8cpu", 8, 1, 800, 40 },
+    { "64cpu", 64, 2, 6000, 160 },
+    { "512cpu", 512, 4, 50000, 600 },
+};
+
+static unsigned long long seed = 88172645463325252ULL;
+
+// xorshift, so every run generates the same fixtures
+static unsigned long long rnd(unsigned long long bound) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed % bound;
+}
+
+// Creates every directory leading up to path
+static void make_dirs(const char *path) {
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s", path);
+    for (char *p = tmp + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            mkdir(tmp, 0755);
+            *p = '/';
+        }
+    }
+    mkdir(tmp, 0755);
+}
+
+static FILE *fixture(const char *root, const char *fmt, ...) {
+    char rel[PATH_MAX / 2], path[PATH_MAX];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(rel, sizeof(rel), fmt, ap);
+    va_end(ap);
+    snprintf(path, sizeof(path), "%s%s", root, rel);
+    char *slash = strrchr(path, '/');
+    *slash = '\0';
+    make_dirs(path);
+    *slash = '/';
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    return f;
+}
+
+static void write_cpu_line(FILE *f, const char *label, unsigned long long scale) {
+    fprintf(f, "%s %llu %llu %llu %llu %llu %llu %llu 0 0 0\n", label, rnd(900000) * scale, rnd(2000) * scale,
+            rnd(300000) * scale, (rnd(4000000) + 1000000) * scale, rnd(20000) * scale, 0ULL, rnd(9000) * scale);
+}
+
+static void write_stat(const char *root, const Host *h) {
+    FILE *f = fixture(root, "/proc/stat");
+    write_cpu_line(f, "cpu ", h->cpus);
+    for (int i = 0; i < h->cpus; i++) {
+        char label[16];
+        snprintf(label, sizeof(label), "cpu%d", i);
+        write_cpu_line(f, label, 1);
+    }
+    fprintf(f, "intr %llu", rnd(1ULL << 40));
+    for (int i = 0; i < 64 + 4 * h->cpus; i++) { //The per-irq counts grow with the number of cpus
+        fprintf(f, " %llu", rnd(8) == 0 ? rnd(100000000) : 0);
+    }
+    fprintf(f, "\nctxt %llu\nbtime 1700000000\nprocesses %llu\nprocs_running %llu\nprocs_blocked %llu\n",
+            rnd(1ULL << 40), rnd(1ULL << 30), rnd(h->cpus) + 1, rnd(4));
+    fprintf(f, "softirq %llu", rnd(1ULL << 36));
+    for (int i = 0; i < 10; i++) {
+        fprintf(f, " %llu", rnd(1ULL << 32));
+    }
+    fprintf(f, "\n");
+    fclose(f);
+}
+
+static void write_meminfo(const char *root, const Host *h) {
+    static const char *keys[] = {
+        "MemTotal", "MemFree", "MemAvailable", "Buffers", "Cached", "SwapCached", "Active", "Inactive",
+        "Active(anon)", "Inactive(anon)", "Active(file)", "Inactive(file)", "Unevictable", "Mlocked",
+        "SwapTotal", "SwapFree", "Zswap", "Zswapped", "Dirty", "Writeback", "AnonPages", "Mapped", "Shmem",
+        "KReclaimable", "Slab", "SReclaimable", "SUnreclaim", "KernelStack", "PageTables", "SecPageTables",
+        "NFS_Unstable", "Bounce", "WritebackTmp", "CommitLimit", "Committed_AS", "VmallocTotal", "VmallocUsed",
+        "VmallocChunk", "Percpu", "HardwareCorrupted", "AnonHugePages", "ShmemHugePages", "ShmemPmdMapped",
+        "FileHugePages", "FilePmdMapped", "Unaccepted", "HugePages_Total", "HugePages_Free", "HugePages_Rsvd",
+        "HugePages_Surp", "Hugepagesize", "Hugetlb", "DirectMap4k", "DirectMap2M", "DirectMap1G",
+    };
+    unsigned long long total = (h->cpus < 2 ? 2 : h->cpus * 4ULL) * 1024 * 1024; //kB
+    FILE *f = fixture(root, "/proc/meminfo");
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        unsigned long long v = i == 0 ? total : rnd(total / 2);
+        if (strncmp(keys[i], "HugePages_", 10) == 0) {
+            fprintf(f, "%-16s%8llu\n", keys[i], 0ULL);
+        }
+        else {
+            char key[32];
+            snprintf(key, sizeof(key), "%s:", keys[i]);
+            fprintf(f, "%-16s%8llu kB\n", key, v);
+        }
+    }
+    fclose(f);
+}
+
+static void write_cpuinfo(const char *root, const Host *h) {
+    static const char *flags = "fpu vme de pse tsc msr pae mce cx8 apic sep mtrr pge mca cmov pat pse36 clflush mmx "
+        "fxsr sse sse2 ht syscall nx mmxext fxsr_opt pdpe1gb rdtscp lm constant_tsc rep_good nopl xtopology "
+        "nonstop_tsc cpuid extd_apicid aperfmperf rapl pni pclmulqdq monitor ssse3 fma cx16 pcid sse4_1 sse4_2 "
+        "x2apic movbe popcnt aes xsave avx f16c rdrand lahf_lm cmp_legacy svm extapic cr8_legacy abm sse4a "
+        "misalignsse 3dnowprefetch osvw ibs skinit wdt tce topoext perfctr_core perfctr_nb bpext perfctr_llc "
+        "mwaitx cpb cat_l3 cdp_l3 hw_pstate ssbd mba ibrs ibpb stibp vmmcall fsgsbase bmi1 avx2 smep bmi2 erms "
+        "invpcid cqm rdt_a avx512f avx512dq rdseed adx smap avx512ifma clflushopt clwb avx512cd sha_ni avx512bw "
+        "avx512vl xsaveopt xsavec xgetbv1 xsaves cqm_llc cqm_occup_llc cqm_mbm_total cqm_mbm_local avx512_bf16 "
+        "clzero irperf xsaveerptr rdpru wbnoinvd amd_ppin cppc arat npt lbrv svm_lock nrip_save tsc_scale "
+        "vmcb_clean flushbyasid decodeassists pausefilter pfthreshold avic v_vmsave_vmload vgif x2avic "
+        "v_spec_ctrl vnmi avx512vbmi umip pku ospke avx512_vbmi2 gfni vaes vpclmulqdq avx512_vnni avx512_bitalg "
+        "avx512_vpopcntdq la57 rdpid overflow_recov succor smca fsrm flush_l1d";
+    int per_socket = h->cpus / h->sockets;
+    FILE *f = fixture(root, "/proc/cpuinfo");
+    for (int i = 0; i < h->cpus; i++) {
+        fprintf(f, "processor\t: %d\nvendor_id\t: AuthenticAMD\ncpu family\t: 25\nmodel\t\t: 17\n"
+                "model name\t: AMD EPYC 9654 96-Core Processor\nstepping\t: 1\nmicrocode\t: 0xa10113e\n"
+                "cpu MHz\t\t: %llu.%03llu\ncache size\t: 1024 KB\nphysical id\t: %d\nsiblings\t: %d\n"
+                "core id\t\t: %d\ncpu cores\t: %d\napicid\t\t: %d\ninitial apicid\t: %d\nfpu\t\t: yes\n"
+                "fpu_exception\t: yes\ncpuid level\t: 16\nwp\t\t: yes\nflags\t\t: %s\n"
+                "bugs\t\t: sysret_ss_attrs spectre_v1 spectre_v2 spec_store_bypass srso\nbogomips\t: 4792.93\n"
+                "TLB size\t: 3584 4K pages\nclflush size\t: 64\ncache_alignment\t: 64\n"
+                "address sizes\t: 52 bits physical, 57 bits virtual\npower management: ts ttp tm hwpstate cpb eff_freq_ro\n\n",
+                i, 1500 + rnd(2200), rnd(1000), i / per_socket, per_socket, i % per_socket, per_socket, i, i, flags);
+    }
+    fclose(f);
+}
+
+static void write_sys_cpus(const char *root, const Host *h) {
+    FILE *f = fixture(root, "/sys/devices/system/cpu/possible");
+    if (h->cpus == 1) {
+        fprintf(f, "0\n");
+    }
+    else {
+        fprintf(f, "0-%d\n", h->cpus - 1);
+    }
+    fclose(f);
+    for (int i = 0; i < h->cpus; i++) {
+        f = fixture(root, "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", i);
+        fprintf(f, "3700000\n");
+        fclose(f);
+        f = fixture(root, "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", i);
+        fprintf(f, "%llu\n", 1500000 + rnd(2200000));
+        fclose(f);
+    }
+    f = fixture(root, "/sys/devices/system/cpu/online");
+    fprintf(f, h->cpus == 1 ? "0\n" : "0-%d\n", h->cpus - 1);
+    fclose(f);
+    //Numbered like x86 does it: every core's first thread, then every second thread, one NUMA node per socket
+    int threads = h->cpus >= 8 ? 2 : 1;
+    int cores = h->cpus / threads, per_socket = cores / h->sockets;
+    for (int i = 0; i < h->cpus; i++) {
+        int core = i % cores;
+        f = fixture(root, "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", i);
+        fprintf(f, "%d\n", core / per_socket);
+        fclose(f);
+        f = fixture(root, "/sys/devices/system/cpu/cpu%d/topology/core_id", i);
+        fprintf(f, "%d\n", core % per_socket);
+        fclose(f);
+        f = fixture(root, "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", i);
+        fprintf(f, threads == 1 ? "%d\n" : "%d,%d\n", core, core + cores);
+        fclose(f);
+    }
+    unsigned long long node_kb = (h->cpus < 2 ? 2 : h->cpus * 4ULL) * 1024 * 1024 / h->sockets;
+    for (int n = 0; n < h->sockets; n++) {
+        f = fixture(root, "/sys/devices/system/node/node%d/cpulist", n);
+        if (threads == 1) {
+            fprintf(f, "%d-%d\n", n * per_socket, (n + 1) * per_socket - 1);
+        }
+        else {
+            fprintf(f, "%d-%d,%d-%d\n", n * per_socket, (n + 1) * per_socket - 1, cores + n * per_socket,
+                    cores + (n + 1) * per_socket - 1);
+        }
+        fclose(f);
+        f = fixture(root, "/sys/devices/system/node/node%d/meminfo", n);
+        unsigned long long free_kb = rnd(node_kb / 2);
+        const char *keys[] = { "MemTotal", "MemFree", "MemUsed", "SwapCached", "Active", "Inactive", "Dirty",
+                               "FilePages", "AnonPages", "Shmem" };
+        unsigned long long values[] = { node_kb, free_kb, node_kb - free_kb, 0, rnd(node_kb / 4), rnd(node_kb / 4),
+                                        rnd(1024), rnd(node_kb / 4), rnd(node_kb / 4), rnd(node_kb / 16) };
+        for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); k++) {
+            char key[32];
+            snprintf(key, sizeof(key), "%s:", keys[k]);
+            fprintf(f, "Node %d %-16s%8llu kB\n", n, key, values[k]);
+        }
+        fprintf(f, "Node %d HugePages_Total:     0\nNode %d HugePages_Free:      0\n", n, n);
+        fclose(f);
+    }
+}
+
+// One /proc/PID directory per process, with the stat file that is all the process panel reads
+static void write_processes(const char *root, const Host *h) {
+    static const char *comms[] = { "systemd", "kworker/0:1", "sshd", "bash", "postgres", "nginx", "java", "python3" };
+    for (int i = 0; i < h->procs; i++) {
+        int pid = 1 + i * 3;
+        const char *comm = comms[rnd(sizeof(comms) / sizeof(comms[0]))];
+        unsigned long long rss = rnd(200000);
+        FILE *f = fixture(root, "/proc/%d/stat", pid);
+        fprintf(f, "%d (%s) S 1 %d %d 0 -1 4194560 %llu 0 %llu 0 %llu %llu 0 0 20 0 %llu 0 %llu %llu %llu "
+                "18446744073709551615 1 1 0 0 0 0 0 4096 16384 0 0 0 17 %llu 0 0 0 0 0 0 0 0 0 0 0 0 0\n",
+                pid, comm, pid, pid, rnd(100000), rnd(100), rnd(1000000), rnd(100000), rnd(64) + 1,
+                rnd(1000000), rnd(1ULL << 34), rss, rnd(h->cpus));
+        fclose(f);
+    }
+}
+
+// A mix of loop devices, NVMe namespaces with partitions and device-mapper volumes
+static void write_diskstats(const char *root, const Host *h) {
+    FILE *f = fixture(root, "/proc/diskstats");
+    for (int i = 0; i < h->disks; i++) {
+        char name[32];
+        int kind = i % 4;
+        if (kind == 0) {
+            snprintf(name, sizeof(name), "loop%d", i / 4);
+        }
+        else if (kind == 1) {
+            snprintf(name, sizeof(name), "nvme%dn1", i / 4);
+        }
+        else if (kind == 2) {
+            snprintf(name, sizeof(name), "nvme%dn1p1", i / 4);
+        }
+        else {
+            snprintf(name, sizeof(name), "dm-%d", i / 4);
+        }
+        fprintf(f, "%4d %7d %s %llu %llu %llu %llu %llu %llu %llu %llu 0 %llu %llu 0 0 0 0 %llu %llu\n",
+                kind == 0 ? 7 : kind == 3 ? 253 : 259, i, name, rnd(1ULL << 30), rnd(1ULL << 20), rnd(1ULL << 36),
+                rnd(1ULL << 30), rnd(1ULL << 30), rnd(1ULL << 20), rnd(1ULL << 36), rnd(1ULL << 30),
+                rnd(1ULL << 32), rnd(1ULL << 34), rnd(1ULL << 20), rnd(1ULL << 24));
+    }
+    fclose(f);
+}
+
+// Pressure of a host under some load, cpu has a full line too since 5.13
+static void write_pressure(const char *root, const Host *h) {
+    static const char *names[] = { "cpu", "memory", "io" };
+    for (int i = 0; i < 3; i++) {
+        FILE *f = fixture(root, "/proc/pressure/%s", names[i]);
+        for (int k = 0; k < 2; k++) {
+            fprintf(f, "%s avg10=%llu.%02llu avg60=%llu.%02llu avg300=%llu.%02llu total=%llu\n", k == 0 ? "some" : "full",
+                    rnd(20), rnd(100), rnd(10), rnd(100), rnd(5), rnd(100), rnd(1ULL << 40));
+        }
+        fclose(f);
+    }
+}
+
+// The fields of a 6.x kernel in its order: the nr_* gauges first, the event counters after
+static void write_vmstat(const char *root, const Host *h) {
+    static const char *keys[] = {
+        "nr_free_pages", "nr_zone_inactive_anon", "nr_zone_active_anon", "nr_zone_inactive_file",
+        "nr_zone_active_file", "nr_zone_unevictable", "nr_zone_write_pending", "nr_mlock", "nr_bounce",
+        "nr_zspages", "nr_free_cma", "numa_hit", "numa_miss", "numa_foreign", "numa_interleave", "numa_local",
+        "numa_other", "nr_inactive_anon", "nr_active_anon", "nr_inactive_file", "nr_active_file",
+        "nr_unevictable", "nr_slab_reclaimable", "nr_slab_unreclaimable", "nr_isolated_anon", "nr_isolated_file",
+        "workingset_nodes", "workingset_refault_anon", "workingset_refault_file", "workingset_activate_anon",
+        "workingset_activate_file", "workingset_restore_anon", "workingset_restore_file", "workingset_nodereclaim",
+        "nr_anon_pages", "nr_mapped", "nr_file_pages", "nr_dirty", "nr_writeback", "nr_writeback_temp",
+        "nr_shmem", "nr_shmem_hugepages", "nr_shmem_pmdmapped", "nr_file_hugepages", "nr_file_pmdmapped",
+        "nr_anon_transparent_hugepages", "nr_vmscan_write", "nr_vmscan_immediate_reclaim", "nr_dirtied",
+        "nr_written", "nr_throttled_written", "nr_kernel_misc_reclaimable", "nr_foll_pin_acquired",
+        "nr_foll_pin_released", "nr_kernel_stack", "nr_page_table_pages", "nr_sec_page_table_pages",
+        "nr_swapcached", "pgpromote_success", "pgpromote_candidate", "nr_dirty_threshold",
+        "nr_dirty_background_threshold", "pgpgin", "pgpgout", "pswpin", "pswpout", "pgalloc_dma",
+        "pgalloc_dma32", "pgalloc_normal", "pgalloc_movable", "pgalloc_device", "allocstall_dma",
+        "allocstall_dma32", "allocstall_normal", "allocstall_movable", "allocstall_device", "pgskip_dma",
+        "pgskip_dma32", "pgskip_normal", "pgskip_movable", "pgskip_device", "pgfree", "pgactivate",
+        "pgdeactivate", "pglazyfree", "pgfault", "pgmajfault", "pglazyfreed", "pgrefill", "pgreuse",
+        "pgsteal_kswapd", "pgsteal_direct", "pgsteal_khugepaged", "pgdemote_kswapd", "pgdemote_direct",
+        "pgdemote_khugepaged", "pgscan_kswapd", "pgscan_direct", "pgscan_khugepaged", "pgscan_direct_throttle",
+        "pgscan_anon", "pgscan_file", "pgsteal_anon", "pgsteal_file", "zone_reclaim_failed", "pginodesteal",
+        "slabs_scanned", "kswapd_inodesteal", "kswapd_low_wmark_hit_quickly", "kswapd_high_wmark_hit_quickly",
+        "pageoutrun", "pgrotated", "drop_pagecache", "drop_slab", "oom_kill", "numa_pte_updates",
+        "numa_huge_pte_updates", "numa_hint_faults", "numa_hint_faults_local", "numa_pages_migrated",
+        "pgmigrate_success", "pgmigrate_fail", "thp_migration_success", "thp_migration_fail",
+        "thp_migration_split", "compact_migrate_scanned", "compact_free_scanned", "compact_isolated",
+        "compact_stall", "compact_fail", "compact_success", "compact_daemon_wake",
+        "compact_daemon_migrate_scanned", "compact_daemon_free_scanned", "htlb_buddy_alloc_success",
+        "htlb_buddy_alloc_fail", "unevictable_pgs_culled", "unevictable_pgs_scanned",
+        "unevictable_pgs_rescued", "unevictable_pgs_mlocked", "unevictable_pgs_munlocked",
+        "unevictable_pgs_cleared", "unevictable_pgs_stranded", "thp_fault_alloc", "thp_fault_fallback",
+        "thp_fault_fallback_charge", "thp_collapse_alloc", "thp_collapse_alloc_failed", "thp_file_alloc",
+        "thp_file_fallback", "thp_file_fallback_charge", "thp_file_mapped", "thp_split_page",
+        "thp_split_page_failed", "thp_deferred_split_page", "thp_split_pmd", "thp_scan_exceed_none_pte",
+        "thp_scan_exceed_swap_pte", "thp_scan_exceed_share_pte", "thp_split_pud", "thp_zero_page_alloc",
+        "thp_zero_page_alloc_failed", "thp_swpout", "thp_swpout_fallback", "balloon_inflate",
+        "balloon_deflate", "balloon_migrate", "swap_ra", "swap_ra_hit", "ksm_swpin_copy", "cow_ksm",
+        "zswpin", "zswpout", "direct_map_level2_splits", "direct_map_level3_splits", "nr_unstable",
+    };
+    FILE *f = fixture(root, "/proc/vmstat");
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        fprintf(f, "%s %llu\n", keys[i], rnd(8) == 0 ? 0 : rnd((unsigned long long)h->cpus << 32));
+    }
+    fclose(f);
+}
+
+// The files a cgroup panel reads in one cgroup v2 directory, rel is "" for the mount itself
+static void write_cgroup(const char *root, const char *rel, int descendants, int limited) {
+    FILE *f = fixture(root, "/sys/fs/cgroup%s/cgroup.stat", rel);
+    fprintf(f, "nr_descendants %d\nnr_dying_descendants 0\n", descendants);
+    fclose(f);
+    f = fixture(root, "/sys/fs/cgroup%s/cpu.stat", rel);
+    unsigned long long usage = rnd(1ULL << 40);
+    fprintf(f, "usage_usec %llu\nuser_usec %llu\nsystem_usec %llu\nnr_periods %llu\nnr_throttled %llu\nthrottled_usec %llu\n",
+            usage, usage / 3 * 2, usage / 3, rnd(1ULL << 24), rnd(1ULL << 16), rnd(1ULL << 32));
+    fclose(f);
+    if (rel[0] == '\0') {
+        return; //The root has no memory.current or limits
+    }
+    f = fixture(root, "/sys/fs/cgroup%s/memory.current", rel);
+    fprintf(f, "%llu\n", rnd(1ULL << 32));
+    fclose(f);
+    f = fixture(root, "/sys/fs/cgroup%s/memory.max", rel);
+    fprintf(f, limited ? "%llu\n" : "max\n", (1ULL << 32) + rnd(1ULL << 32));
+    fclose(f);
+    f = fixture(root, "/sys/fs/cgroup%s/cpu.max", rel);
+    fprintf(f, limited ? "%llu 100000\n" : "max 100000\n", 50000 + rnd(400000));
+    fclose(f);
+}
+
+// A kubernetes-like tree: one pod of two containers for every 50 processes
+static void write_cgroups(const char *root, const Host *h) {
+    int pods = h->procs / 50 > 0 ? h->procs / 50 : 1;
+    fclose(fixture(root, "/sys/fs/cgroup/cgroup.controllers"));
+    write_cgroup(root, "", 1 + pods * 3, 0);
+    write_cgroup(root, "/kubepods.slice", pods * 3, 0);
+    for (int i = 0; i < pods; i++) {
+        char rel[64];
+        snprintf(rel, sizeof(rel), "/kubepods.slice/pod%d", i);
+        write_cgroup(root, rel, 2, 1);
+        for (int k = 0; k < 2; k++) {
+            snprintf(rel, sizeof(rel), "/kubepods.slice/pod%d/ctr%d", i, k);
+            write_cgroup(root, rel, 0, 1);
+        }
+    }
+}
+
+// lo, a few physical ports and one veth per eight cpus, like a container host
+static void write_net_dev(const char *root, const Host *h) {
+    FILE *f = fixture(root, "/proc/net/dev");
+    int n = 2 + h->cpus / 8;
+    fprintf(f, "Inter-|   Receive                                                |  Transmit\n"
+               " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n");
+    for (int i = 0; i < n; i++) {
+        char name[NET_NAME];
+        if (i == 0) {
+            snprintf(name, sizeof(name), "lo");
+        }
+        else if (i <= 2) {
+            snprintf(name, sizeof(name), "eth%d", i - 1);
+        }
+        else {
+            snprintf(name, sizeof(name), "veth%04x", (unsigned)rnd(65536));
+        }
+        fprintf(f, "%6s: %llu %llu 0 %llu 0 0 0 %llu %llu %llu 0 %llu 0 0 0 0\n", name, rnd(1ULL << 44), rnd(1ULL << 34),
+                rnd(1000), rnd(1ULL << 20), rnd(1ULL << 44), rnd(1ULL << 34), rnd(1000));
+    }
+    fclose(f);
+}
+
+// Generates the fixture of host under dir unless an earlier run already did
+static void make_fixture(const char *dir, const Host *h, char *root) {
+    snprintf(root, PATH_MAX / 2, "%s/%s", dir, h->name);
+    char done[PATH_MAX];
+    snprintf(done, sizeof(done), "%s/.complete-v%d", root, FIXTURE_VERSION);
+    if (access(done, F_OK) == 0) {
+        return;
+    }
+    fprintf(stderr, "generating %s\n", root);
+    write_stat(root, h);
+    write_meminfo(root, h);
+    write_cpuinfo(root, h);
+    write_sys_cpus(root, h);
+    write_processes(root, h);
+    write_diskstats(root, h);
+    write_net_dev(root, h);
+    write_pressure(root, h);
+    write_vmstat(root, h);
+    write_cgroups(root, h);
+    close(open(done, O_WRONLY | O_CREAT | O_CLOEXEC, 0644));
+}
+
+typedef void (*bench_fn)(void *ctx);
+
+static volatile float sink; //Keeps the compiler from dropping the benchmarked calls
+
+// Doubles the iteration count until a run takes BENCH_MIN_NS, then reports the time per call
+static void bench(const char *name, const Host *h, bench_fn fn, void *ctx) {
+    fn(ctx); //Warm up, opens the files and sizes the buffers
+    long iters = 1;
+    long long elapsed;
+    for (;;) {
+        long long start = now_ns();
+        for (long i = 0; i < iters; i++) {
+            fn(ctx);
+        }
+        elapsed = now_ns() - start;
+        if (elapsed >= BENCH_MIN_NS) {
+            break;
+        }
+        iters *= 2;
+    }
+    printf("%-24s %-8s %12.0f ns/op %10ld ops\n", name, h->name, (double)elapsed / iters, iters);
+    fflush(stdout);
+}
+
+static void bench_cpu_utilization(void *ctx) {
+    sink = get_cpu_utilization().total;
+}
+
+static void bench_stat_read(void *ctx) {
+    StatSample *s = ctx;
+    if (stat_read(s) == -1) {
+        exit(1);
+    }
+}
+
+// One tick's worth: the aggregate and every core
+static void bench_cpu_percentage(void *ctx) {
+    StatSample *s = ctx;
+    float sum = 0;
+    for (int i = 0; i < s[0].ncores; i++) {
+        sum += get_cpu_percentage(s[0].core[i], s[1].core[i]);
+    }
+    sink = sum + get_cpu_percentage(s[0].cpu, s[1].cpu);
+}
+
+static void bench_ram_y(void *ctx) {
+    sink = get_ram_y();
+}
+
+static void bench_cpuinfo(void *ctx) {
+    sink = cpuinfo_count();
+}
+
+static void bench_online(void *ctx) {
+    sink = cpu_online_count();
+}
+
+static void bench_node_memory(void *ctx) {
+    Topology *t = ctx;
+    topo_read_memory(t);
+    sink = t->node[0].mem_used;
+}
+
+static void bench_disk(void *ctx) {
+    disk_read(ctx, now_ns());
+}
+
+static void bench_net(void *ctx) {
+    net_read(ctx, now_ns());
+}
+
+static void bench_freq(void *ctx) {
+    FreqTable *t = ctx;
+    if (freq_read(t) == -1) {
+        exit(1);
+    }
+    sink = t->ghz[0];
+}
+
+// The /proc/stat counters are copied from a read the cpu collector made, so this is /proc/vmstat
+static void bench_kstat(void *ctx) {
+    KernelStats *k = ctx;
+    static StatSample s;
+    kstat_update(k, &s, now_ns());
+    sink = k->now[KSTAT_PGFAULT];
+}
+
+static void bench_psi(void *ctx) {
+    psi_read(ctx, now_ns());
+}
+
+static void bench_cgroups(void *ctx) {
+    CgroupTable *t = ctx;
+    cgroup_read(t, now_ns());
+    sink = t->ntop;
+}
+
+static void bench_procs(void *ctx) {
+    ProcTable *t = ctx;
+    procs_scan(t, now_ns());
+    sink = t->ntop;
+}
+
+static void bench_shm_publish(void *ctx) {
+    Shm *m = ctx;
+    static Sample s;
+    s.cpu = sink + 1;
+    s.ncores = m->seg->ncores;
+    shm_publish(m, &s, 1);
+}
+
+static void bench_shm_snapshot(void *ctx) {
+    static Sample s;
+    shm_snapshot(ctx, &s, NULL, NULL);
+    sink = s.cpu;
+}
+
+// State of the plotting benchmarks: a screen as show() would set it up for the host
+typedef struct {
+    layout l;
+    info flags;
+    Sample sample;
+    int x;
+} plot_state;
+
+static void next_sample(plot_state *p) {
+    p->x = p->x % BENCH_COLS + 1;
+    p->sample.cpu = rnd(10000) / 100.0;
+    p->sample.mem_used = rnd((unsigned long long)p->l.totalram * 50) / 100.0;
+    p->sample.mem_available = p->l.totalram - p->sample.mem_used;
+    p->sample.mem_cached = rnd((unsigned long long)p->l.totalram * 25) / 100.0;
+    for (int i = 0; i < p->sample.ncores; i++) {
+        p->sample.core[i] = rnd(10000) / 100.0;
+    }
+}
+
+static void bench_plot_memory(void *ctx) {
+    plot_state *p = ctx;
+    next_sample(p);
+    plot_memory(p->x, &p->sample, &p->l, p->flags);
+}
+
+static void bench_plot_cpu(void *ctx) {
+    plot_state *p = ctx;
+    next_sample(p);
+    plot_cpu(p->x, &p->sample, &p->l, p->flags);
+}
+
+// Everything drawn for one tick, including the diff and the write to the terminal
+static void bench_frame(void *ctx) {
+    plot_state *p = ctx;
+    next_sample(p);
+    plot_memory(p->x, &p->sample, &p->l, p->flags);
+    plot_cpu(p->x, &p->sample, &p->l, p->flags);
+    end_frame(&p->l, p->flags);
+}
+
+static void bench_plot_procs(void *ctx) {
+    plot_procs(ctx);
+}
+
+// Growing totals, so the graph rescales every so often like a real ramp-up would
+static void bench_plot_net(void *ctx) {
+    plot_state *p = ctx;
+    p->x = p->x % BENCH_COLS + 1;
+    p->l.net->rx_bps = rnd(1ULL << (10 + p->x / 4));
+    p->l.net->tx_bps = rnd(1ULL << (10 + p->x / 4));
+    if (p->x == 1) {
+        p->l.net_points = 0;
+    }
+    plot_net(p->x, &p->l);
+}
+
+static void bench_host(const char *dir, const Host *h) {
+    char root[PATH_MAX / 2];
+    make_fixture(dir, h, root);
+    sampler_set_root(root);
+
+    bench("get_cpu_utilization", h, bench_cpu_utilization, NULL);
+    StatSample s[2];
+    if (stat_init(&s[0]) == -1 || stat_init(&s[1]) == -1 || stat_read(&s[0]) == -1) {
+        exit(1);
+    }
+    bench("stat_read per-core", h, bench_stat_read, &s[1]);
+    for (int i = 0; i < s[1].ncores; i++) { //Some ticks between the two samples so nothing divides by zero
+        s[1].core[i].total += 100;
+        s[1].core[i].idle += rnd(100);
+    }
+    s[1].cpu.total += 100 * s[1].ncores;
+    bench("get_cpu_percentage all", h, bench_cpu_percentage, s);
+    stat_free(&s[0]);
+    stat_free(&s[1]);
+    bench("get_ram_y", h, bench_ram_y, NULL);
+    bench("cpuinfo scan", h, bench_cpuinfo, NULL);
+    bench("cpu_online_count", h, bench_online, NULL);
+    Topology topo;
+    if (topo_init(&topo) == -1) {
+        exit(1);
+    }
+    bench("topo_read_memory", h, bench_node_memory, &topo);
+    DiskTable disks;
+    if (disk_init(&disks, NULL) == -1) {
+        exit(1);
+    }
+    bench("disk_read", h, bench_disk, &disks);
+    disk_free(&disks);
+    NetTable net;
+    if (net_init(&net) == -1) {
+        exit(1);
+    }
+    bench("net_read", h, bench_net, &net);
+    PsiTable psi;
+    if (psi_init(&psi, 150000, 1000000) == -1) { //No triggers on fixture files, it is only read
+        exit(1);
+    }
+    bench("psi_read", h, bench_psi, &psi);
+    psi_free(&psi);
+    KernelStats kstat;
+    StatSample none;
+    memset(&none, 0, sizeof(none));
+    kstat_init(&kstat, &none, now_ns());
+    bench("kstat_update", h, bench_kstat, &kstat);
+    FreqTable freq;
+    if (freq_init(&freq, cpu_count()) == -1) {
+        exit(1);
+    }
+    bench("freq_read sysfs", h, bench_freq, &freq);
+    FreqTable fallback; //Same cpus read through the /proc/cpuinfo fallback
+    memset(&fallback, 0, sizeof(fallback));
+    fallback.n = freq.n;
+    fallback.ghz = freq.ghz;
+    char path[PATH_MAX];
+    if (proc_open(&fallback.cpuinfo, proc_path("/proc/cpuinfo", path)) == -1) {
+        perror("unable to open the /proc/cpuinfo fixture");
+        exit(1);
+    }
+    fallback.source = FREQ_CPUINFO;
+    bench("freq_read cpuinfo", h, bench_freq, &fallback);
+    proc_close(&fallback.cpuinfo);
+    ProcTable procs;
+    if (procs_init(&procs, 10, PROCS_BY_CPU) == -1) {
+        exit(1);
+    }
+    bench("procs_scan top 10", h, bench_procs, &procs);
+    procs.budget_ns = 500000000LL * PROCS_BUDGET_PCT / 100; //What the default --tdelay allows
+    bench("procs_scan slice", h, bench_procs, &procs);
+    CgroupTable cgroups;
+    if (cgroup_init(&cgroups, "/", 1, CGROUP_ROWS) == -1) {
+        exit(1);
+    }
+    cgroup_read(&cgroups, now_ns()); //The first read walks everything, the benchmark measures the steady state
+    bench("cgroup_read subtree", h, bench_cgroups, &cgroups);
+    cgroup_free(&cgroups);
+
+    plot_state p;
+    memset(&p, 0, sizeof(p));
+    p.flags.samples = BENCH_COLS;
+    p.flags.memory = p.flags.cpu = p.flags.cores = 1;
+    p.l.mrow = 5;
+    p.l.cpurow = 22;
+    p.l.coresrow = 38;
+    p.l.cores = cpuinfo_count();
+    p.l.freq = &freq;
+    p.l.totalram = get_ram();
+    p.sample.ncores = p.l.cores < MAX_CORES ? p.l.cores : MAX_CORES;
+    int x, y;
+    core_position(p.l.cores - 1, p.l.cores, p.l.coresrow, &x, &y);
+    p.l.bottom = y + 5; //The process and network panels go below, in the 40 extra rows of the screen
+    int width = p.l.cores / (int)sqrt(p.l.cores);
+    int cols = 8 * width > offset + BENCH_COLS + 2 ? 8 * width : offset + BENCH_COLS + 2;
+    int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    Screen scr;
+    if (fd == -1 || screen_init(&scr, fd, p.l.bottom + 40, cols) == -1) {
+        perror("unable to set up the benchmark screen");
+        exit(1);
+    }
+    p.l.scr = &scr;
+    draw_axes(&scr, MEM_SCALE, BENCH_COLS, "0 GB", "GB", p.l.mrow);
+    draw_axes(&scr, CPU_Y, BENCH_COLS, "  0%", "100%", p.l.cpurow);
+    plot_cores(&p.l);
+    end_frame(&p.l, p.flags);
+
+    bench("plot_memory", h, bench_plot_memory, &p);
+    p.flags.mem_stack = 1;
+    bench("plot_memory stacked", h, bench_plot_memory, &p);
+    p.flags.mem_stack = 0;
+    bench("plot_cpu with cores", h, bench_plot_cpu, &p);
+    bench("frame", h, bench_frame, &p);
+    Canvas mem_canvas, cpu_canvas;
+    if (canvas_init(&mem_canvas, &scr, p.l.mrow, offset + 1, MEM_SCALE, graph_cells(BENCH_COLS, 1)) == -1
+        || canvas_init(&cpu_canvas, &scr, p.l.cpurow, offset + 1, CPU_Y, graph_cells(BENCH_COLS, 1)) == -1) {
+        exit(1);
+    }
+    p.l.mem_canvas = &mem_canvas;
+    p.l.cpu_canvas = &cpu_canvas;
+    bench("plot_memory braille", h, bench_plot_memory, &p);
+    bench("plot_cpu braille", h, bench_plot_cpu, &p);
+    p.l.mem_canvas = p.l.cpu_canvas = NULL;
+    canvas_free(&mem_canvas);
+    canvas_free(&cpu_canvas);
+    p.l.procrow = p.l.bottom + 3;
+    p.l.procs = &procs;
+    bench("plot_procs", h, bench_plot_procs, &p.l);
+    float rx[BENCH_COLS], tx[BENCH_COLS];
+    memset(rx, 0, sizeof(rx));
+    memset(tx, 0, sizeof(tx));
+    p.l.net = &net;
+    p.l.netrow = p.l.bottom + 3;
+    p.l.net_rows = 0;
+    p.l.net_rx = rx;
+    p.l.net_tx = tx;
+    p.l.net_cols = BENCH_COLS;
+    bench("plot_net", h, bench_plot_net, &p);
+    p.l.topo = &topo; //The same cores grouped by node, on a screen of their own
+    p.l.cores = topo.ncpus;
+    p.l.cell = calloc(topo.ncpus, sizeof(Cell));
+    p.l.block = calloc(topo.nnodes, sizeof(Cell));
+    if (p.l.cell == NULL || p.l.block == NULL) {
+        perror("calloc error, unable to allocate the cores grid");
+        exit(1);
+    }
+    int grouped_cols = grid_layout(&p.l, cols);
+    Screen grouped;
+    if (screen_init(&grouped, fd, p.l.bottom + 1, grouped_cols > cols ? grouped_cols : cols) == -1) {
+        exit(1);
+    }
+    p.l.scr = &grouped;
+    plot_cores(&p.l);
+    bench("plot_cpu with nodes", h, bench_plot_cpu, &p);
+    p.l.scr = &scr;
+    screen_free(&grouped);
+    free(p.l.cell);
+    free(p.l.block);
+    topo_free(&topo);
+    Shm writer, reader;
+    char name[32];
+    snprintf(name, sizeof(name), "sysmon_bench_%d", getpid());
+    if (shm_create(&writer, name, p.sample.ncores) == -1 || shm_attach(&reader, name) == -1) {
+        exit(1);
+    }
+    bench("shm_publish", h, bench_shm_publish, &writer);
+    bench("shm_snapshot", h, bench_shm_snapshot, &reader);
+    shm_close(&reader);
+    shm_close(&writer);
+    net_free(&net);
+    freq_free(&freq);
+    procs_free(&procs);
+    printf("%-24s %-8s %12.0f bytes/frame\n", "frame output", h->name,
+           scr.frames > 0 ? (double)scr.total_bytes / scr.frames : 0.0);
+    screen_free(&scr);
+    close(fd);
+}
+
+// Usage: A3_bench [fixture dir] [host name]...
+int main(int argc, char **argv) {
+    const char *dir = argc > 1 ? argv[1] : "bench_fixtures";
+    make_dirs(dir);
+    for (size_t i = 0; i < sizeof(hosts) / sizeof(hosts[0]); i++) {
+        int wanted = argc <= 2;
+        for (int a = 2; a < argc; a++) {
+            wanted |= strcmp(argv[a], hosts[i].name) == 0;
+        }
+        if (wanted) {
+            bench_host(dir, &hosts[i]);
+        }
+    }
+    return 0;
+}
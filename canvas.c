@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "canvas.h"
+
+#define BRAILLE_BASE 0x2800
+
+// Bit of the dot at (dx, dy) of a cell, dy counted from the top: the first three rows of each
+// column are bits 0-2 and 3-5, the bottom row was added later as bits 6 and 7
+static const uint8_t braille_bit[CANVAS_DOTS_Y][CANVAS_DOTS_X] = {
+    { 0x01, 0x08 },
+    { 0x02, 0x10 },
+    { 0x04, 0x20 },
+    { 0x40, 0x80 },
+};
+
+int canvas_init(Canvas *c, Screen *scr, int row, int col, int rows, int cols) {
+    memset(c, 0, sizeof(*c));
+    c->scr = scr;
+    c->row = row;
+    c->col = col;
+    c->rows = rows;
+    c->cols = cols;
+    c->dots = calloc((size_t)rows * cols, 1);
+    c->color = calloc((size_t)rows * cols, 1);
+    if (c->dots == NULL || c->color == NULL) {
+        perror("calloc error, unable to allocate the graph canvas");
+        canvas_free(c);
+        return -1;
+    }
+    c->mono = getenv("NO_COLOR") != NULL && getenv("NO_COLOR")[0] != '\0';
+    for (int i = 0; i < CANVAS_SERIES; i++) {
+        c->last_x[i] = -2; //No last point, the first one is not joined to anything
+    }
+    return 0;
+}
+
+void canvas_free(Canvas *c) {
+    free(c->dots);
+    free(c->color);
+    c->dots = c->color = NULL;
+}
+
+// Dot row of v on a graph whose top dot is top, clipped to the canvas
+int canvas_y(const Canvas *c, float v, float top) {
+    int height = c->rows * CANVAS_DOTS_Y;
+    int y = top > 0 ? (int)(v / top * (height - 1) + 0.5) : 0;
+    return y < 0 ? 0 : y >= height ? height - 1 : y;
+}
+
+// Empties every cell, the screen is left to the caller
+void canvas_clear(Canvas *c) {
+    memset(c->dots, 0, (size_t)c->rows * c->cols);
+    memset(c->color, 0, (size_t)c->rows * c->cols);
+    for (int i = 0; i < CANVAS_SERIES; i++) {
+        c->last_x[i] = -2;
+    }
+}
+
+// Empties dot column x, before it is drawn again
+void canvas_clear_x(Canvas *c, int x) {
+    int cell = x / CANVAS_DOTS_X;
+    if (x < 0 || cell >= c->cols) {
+        return;
+    }
+    uint8_t keep = 0;
+    for (int dy = 0; dy < CANVAS_DOTS_Y; dy++) {
+        keep |= braille_bit[dy][1 - x % CANVAS_DOTS_X]; //The other column of the cell
+    }
+    for (int r = 0; r < c->rows; r++) {
+        c->dots[r * c->cols + cell] &= keep;
+    }
+}
+
+// Sets the dots of column x from y0 to y1, both included
+void canvas_vline(Canvas *c, int x, int y0, int y1, int color) {
+    int cell = x / CANVAS_DOTS_X;
+    if (x < 0 || cell >= c->cols) {
+        return;
+    }
+    if (y0 > y1) {
+        int t = y0;
+        y0 = y1;
+        y1 = t;
+    }
+    int height = c->rows * CANVAS_DOTS_Y;
+    for (int y = y0 < 0 ? 0 : y0; y <= y1 && y < height; y++) {
+        int from_top = height - 1 - y;
+        int i = (from_top / CANVAS_DOTS_Y) * c->cols + cell;
+        c->dots[i] |= braille_bit[from_top % CANVAS_DOTS_Y][x % CANVAS_DOTS_X];
+        c->color[i] = c->mono ? 0 : color;
+    }
+}
+
+// Adds the point (x, y) to a line series. When the series was last drawn in the column before,
+// column x also covers the rise or fall from there, so the line stays connected
+void canvas_line(Canvas *c, int series, int x, int y, int color) {
+    canvas_vline(c, x, c->last_x[series] == x - 1 ? c->last_y[series] : y, y, color);
+    c->last_x[series] = x;
+    c->last_y[series] = y;
+}
+
+// Copies the cells holding dot column x to the screen
+void canvas_show(Canvas *c, int x) {
+    int cell = x / CANVAS_DOTS_X;
+    if (x < 0 || cell >= c->cols) {
+        return;
+    }
+    for (int r = 0; r < c->rows; r++) {
+        int i = r * c->cols + cell;
+        uint32_t ch = c->dots[i] != 0 ? (BRAILLE_BASE + c->dots[i]) | SCREEN_COLOR(c->color[i]) : ' ';
+        screen_set(c->scr, c->row + r, c->col + cell, ch);
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef CANVAS_H
+#define CANVAS_H
+
+#include <stdint.h>
+#include "screen.h"
+
+#define CANVAS_DOTS_X 2    // Braille dots per cell across
+#define CANVAS_DOTS_Y 4    // and down
+#define CANVAS_SERIES 8    // line series that remember their last point
+
+// A graph area of rows x cols cells drawn with Braille patterns, so every cell holds 2 x 4 dots.
+// Each cell keeps its dot mask and the color of the series that drew into it last, so several
+// series overlay in one graph. Dot x counts from the left, dot y from the bottom
+typedef struct {
+    Screen *scr;
+    int row, col;          // screen position of the top-left cell
+    int rows, cols;
+    uint8_t *dots;
+    uint8_t *color;        // ANSI color 1 to 7, 0 is the terminal's default
+    int mono;              // NO_COLOR is set, every series is drawn in the default color
+    int last_x[CANVAS_SERIES], last_y[CANVAS_SERIES]; // where each line series was drawn last
+} Canvas;
+
+int canvas_init(Canvas *c, Screen *scr, int row, int col, int rows, int cols);
+void canvas_free(Canvas *c);
+int canvas_y(const Canvas *c, float v, float top);
+void canvas_clear(Canvas *c);
+void canvas_clear_x(Canvas *c, int x);
+void canvas_vline(Canvas *c, int x, int y0, int y1, int color);
+void canvas_line(Canvas *c, int series, int x, int y, int color);
+void canvas_show(Canvas *c, int x);
+
+#endif
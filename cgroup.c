@@ -0,0 +1,440 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/resource.h>
+#include "cgroup.h"
+#include "sampler.h"
+
+#define CGROUP_START_CAP 64
+#define CGROUP_DELETED ((Cgroup *)1) // tombstone, keeps the probe chains behind it intact
+
+static size_t cg_hash(const char *path) {
+    size_t h = 14695981039346656037ULL; //FNV-1a
+    for (const char *p = path; *p; p++) {
+        h = (h ^ (unsigned char)*p) * 1099511628211ULL;
+    }
+    return h;
+}
+
+// The slot of path, or the one it should go in when it is not in the table
+static Cgroup **cg_slot(CgroupTable *t, const char *path) {
+    size_t mask = t->cap - 1;
+    size_t i = cg_hash(path) & mask;
+    Cgroup **tomb = NULL;
+    for (;;) {
+        Cgroup **s = &t->slot[i];
+        if (*s == NULL) {
+            return tomb != NULL ? tomb : s;
+        }
+        if (*s == CGROUP_DELETED) {
+            if (tomb == NULL) {
+                tomb = s;
+            }
+        }
+        else if (strcmp((*s)->path, path) == 0) {
+            return s;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+// Rehashes the live entries into cap slots, which also drops the tombstones
+static int cg_resize(CgroupTable *t, size_t cap) {
+    Cgroup **old = t->slot;
+    size_t old_cap = t->cap;
+    t->slot = calloc(cap, sizeof(Cgroup *));
+    if (t->slot == NULL) {
+        t->slot = old;
+        return -1;
+    }
+    t->cap = cap;
+    t->deleted = 0;
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i] != NULL && old[i] != CGROUP_DELETED) {
+            *cg_slot(t, old[i]->path) = old[i];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+static void cg_close(Cgroup *c) {
+    if (c->stat_fd != -1) {
+        close(c->stat_fd);
+    }
+    if (c->mem_fd != -1) {
+        close(c->mem_fd);
+    }
+    close(c->dirfd);
+    free(c);
+}
+
+// Reads a small file of the cgroup into buf. fd is the cached one, -1 opens it just for this read
+static ssize_t cg_read_file(const Cgroup *c, int fd, const char *name, char *buf, size_t len) {
+    int tmp = -1;
+    if (fd == -1) {
+        tmp = fd = openat(c->dirfd, name, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            return -1;
+        }
+    }
+    ssize_t n = pread(fd, buf, len - 1, 0);
+    if (tmp != -1) {
+        close(tmp);
+    }
+    if (n < 0) {
+        return -1; //ENODEV once the cgroup is removed
+    }
+    buf[n] = '\0';
+    return n;
+}
+
+// The value after key in a "key value" per line file, 0 when it is not there
+static unsigned long long cg_field(const char *buf, const char *key) {
+    size_t len = strlen(key);
+    const char *p = buf;
+    while (p != NULL && *p != '\0') {
+        if (strncmp(p, key, len) == 0 && p[len] == ' ') {
+            p += len;
+            return scan_u64(&p);
+        }
+        p = strchr(p, '\n');
+        p = p != NULL ? p + 1 : NULL;
+    }
+    return 0;
+}
+
+static unsigned long long cg_descendants(const Cgroup *c) {
+    char buf[128];
+    if (cg_read_file(c, -1, "cgroup.stat", buf, sizeof(buf)) == -1) {
+        return 0;
+    }
+    return cg_field(buf, "nr_descendants");
+}
+
+// cpu.max is "max 100000" or "QUOTA PERIOD" in µs, memory.max is "max" or bytes
+static void cg_limits(Cgroup *c) {
+    char buf[64];
+    c->quota = 0;
+    if (cg_read_file(c, -1, "cpu.max", buf, sizeof(buf)) > 0 && buf[0] != 'm') {
+        const char *p = buf;
+        unsigned long long quota = scan_u64(&p);
+        unsigned long long period = scan_u64(&p);
+        c->quota = period > 0 ? (float)quota / period : 0;
+    }
+    c->mem_max = 0;
+    if (cg_read_file(c, -1, "memory.max", buf, sizeof(buf)) > 0 && buf[0] != 'm') {
+        const char *p = buf;
+        c->mem_max = scan_u64(&p);
+    }
+}
+
+// Opens the cgroup name below parent, or the given one when parent is NULL
+static Cgroup *cg_open(CgroupTable *t, Cgroup *parent, const char *name, const char *path) {
+    Cgroup *c = calloc(1, sizeof(Cgroup));
+    if (c == NULL) {
+        return NULL;
+    }
+    snprintf(c->path, sizeof(c->path), "%s", path);
+    c->dirfd = parent != NULL ? openat(parent->dirfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC)
+                              : open(name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (c->dirfd == -1) {
+        free(c);
+        t->skipped++; //Removed since the walk listed it, or out of fds
+        return NULL;
+    }
+    c->stat_fd = openat(c->dirfd, "cpu.stat", O_RDONLY | O_CLOEXEC);
+    c->mem_fd = openat(c->dirfd, "memory.current", O_RDONLY | O_CLOEXEC);
+    c->has_mem = c->mem_fd != -1 || errno == EMFILE || errno == ENFILE; //Out of fds, it is opened per read instead
+    c->descendants = cg_descendants(c);
+    cg_limits(c);
+    c->fresh = 1;
+    return c;
+}
+
+// Adds c to the table, which grows to keep the load under a half
+static int cg_insert(CgroupTable *t, Cgroup *c) {
+    if ((t->used + t->deleted + 1) * 2 > t->cap && cg_resize(t, t->used * 4 > t->cap ? t->cap * 2 : t->cap) == -1) {
+        return -1;
+    }
+    Cgroup **s = cg_slot(t, c->path);
+    if (*s == CGROUP_DELETED) {
+        t->deleted--;
+    }
+    *s = c;
+    t->used++;
+    return 0;
+}
+
+// Lists dir and descends into every child that is new, or whose nr_descendants changed since
+// the last walk. force descends into all of them
+static void cg_walk(CgroupTable *t, Cgroup *dir, int force) {
+    int fd = dup(dir->dirfd);
+    DIR *d = fd != -1 ? fdopendir(fd) : NULL;
+    if (d == NULL) {
+        if (fd != -1) {
+            close(fd);
+        }
+        return;
+    }
+    rewinddir(d); //The dup shares the offset of the last listing
+    t->walked++;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if ((de->d_type != DT_DIR && de->d_type != DT_UNKNOWN) || de->d_name[0] == '.') {
+            continue; //Only directories are cgroups, and none starts with '.'
+        }
+        char path[CGROUP_PATH];
+        if (snprintf(path, sizeof(path), "%s/%s", strcmp(dir->path, "/") == 0 ? "" : dir->path, de->d_name) >= (int)sizeof(path)) {
+            t->skipped++;
+            continue;
+        }
+        Cgroup **s = cg_slot(t, path);
+        Cgroup *c = *s != NULL && *s != CGROUP_DELETED ? *s : NULL;
+        if (c == NULL) {
+            c = cg_open(t, dir, de->d_name, path);
+            if (c == NULL) {
+                continue;
+            }
+            if (cg_insert(t, c) == -1) {
+                cg_close(c);
+                continue;
+            }
+            c->seen = t->walk;
+            cg_walk(t, c, 1); //Everything below a new cgroup is new too
+            continue;
+        }
+        c->seen = t->walk;
+        unsigned long long n = cg_descendants(c);
+        if (force || n != c->descendants) {
+            c->descendants = n;
+            cg_walk(t, c, force);
+        }
+    }
+    closedir(d);
+}
+
+// Opens path relative to the cgroup2 mount, "" or "/" for all of it. With subtree every
+// cgroup below it is read too
+int cgroup_init(CgroupTable *t, const char *path, int subtree, int top_n) {
+    memset(t, 0, sizeof(*t));
+    t->subtree = subtree;
+    t->root_stat_fd = -1;
+    t->ncpus = cpu_count();
+    while (*path == '/') {
+        path++;
+    }
+    char mount[PATH_MAX];
+    proc_path("/sys/fs/cgroup/cgroup.controllers", mount);
+    if (access(mount, F_OK) == 0) {
+        proc_path("/sys/fs/cgroup", mount);
+    }
+    else {
+        proc_path("/sys/fs/cgroup/unified", mount); //systemd's hybrid layout, v1 controllers with v2 beside them
+    }
+    snprintf(t->root, sizeof(t->root), "%s", mount);
+    char full[PATH_MAX * 2];
+    snprintf(full, sizeof(full), "%s/%s", mount, path);
+    char rel[CGROUP_PATH];
+    snprintf(rel, sizeof(rel), "/%s", path);
+    size_t len = strlen(rel);
+    while (len > 1 && rel[len - 1] == '/') {
+        rel[--len] = '\0'; //"system.slice/" is "/system.slice"
+    }
+
+    struct rlimit rl; //Three fds per cgroup, a large tree needs more than the usual 1024
+    if (subtree && getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    t->cap = CGROUP_START_CAP;
+    t->slot = calloc(t->cap, sizeof(Cgroup *));
+    t->top = malloc((top_n > 0 ? top_n : 1) * sizeof(Cgroup *));
+    if (t->slot == NULL || t->top == NULL) {
+        perror("malloc error, unable to allocate the cgroup table");
+        cgroup_free(t);
+        return -1;
+    }
+    t->top_n = top_n;
+    t->top_cg = cg_open(t, NULL, full, rel);
+    if (t->top_cg == NULL || t->top_cg->stat_fd == -1) {
+        fprintf(stderr, "%s is not a cgroup v2 directory\n", full);
+        if (t->top_cg != NULL) {
+            cg_close(t->top_cg);
+            t->top_cg = NULL;
+        }
+        cgroup_free(t);
+        return -1;
+    }
+    cg_insert(t, t->top_cg);
+    if (subtree) {
+        t->root_stat_fd = openat(t->top_cg->dirfd, "cgroup.stat", O_RDONLY | O_CLOEXEC);
+        t->walk = 1;
+        t->top_cg->seen = t->walk;
+        cg_walk(t, t->top_cg, 1);
+    }
+    return cgroup_read(t, 0);
+}
+
+void cgroup_free(CgroupTable *t) {
+    for (size_t i = 0; i < t->cap && t->slot != NULL; i++) {
+        if (t->slot[i] != NULL && t->slot[i] != CGROUP_DELETED) {
+            cg_close(t->slot[i]);
+        }
+    }
+    if (t->root_stat_fd != -1) {
+        close(t->root_stat_fd);
+        t->root_stat_fd = -1;
+    }
+    free(t->slot);
+    free(t->top);
+    t->slot = NULL;
+    t->top = NULL;
+    t->top_cg = NULL;
+    t->cap = t->used = t->deleted = 0;
+}
+
+// Re-reads the counters of c, -1 once the cgroup is gone
+static int cg_sample(Cgroup *c, double dt, int ncpus) {
+    char buf[512];
+    if (cg_read_file(c, c->stat_fd, "cpu.stat", buf, sizeof(buf)) == -1) {
+        return -1;
+    }
+    unsigned long long usage = cg_field(buf, "usage_usec");
+    unsigned long long periods = cg_field(buf, "nr_periods");
+    unsigned long long throttled = cg_field(buf, "nr_throttled");
+    unsigned long long throttled_usec = cg_field(buf, "throttled_usec");
+    if (!c->fresh && dt > 0) {
+        float cpus = c->quota > 0 ? c->quota : ncpus;
+        c->cpu = usage >= c->usage_usec ? (usage - c->usage_usec) / (dt * 1e6) * 100 / cpus : 0;
+        c->throttled = periods > c->nr_periods && throttled >= c->nr_throttled
+                     ? (float)(throttled - c->nr_throttled) / (periods - c->nr_periods) * 100 : 0;
+        c->throttled_ms = throttled_usec >= c->throttled_usec ? (throttled_usec - c->throttled_usec) / 1000.0 / dt : 0;
+    }
+    c->fresh = 0;
+    c->usage_usec = usage;
+    c->nr_periods = periods;
+    c->nr_throttled = throttled;
+    c->throttled_usec = throttled_usec;
+    if (c->has_mem) {
+        if (cg_read_file(c, c->mem_fd, "memory.current", buf, sizeof(buf)) == -1) {
+            return -1;
+        }
+        const char *p = buf;
+        c->mem_current = scan_u64(&p);
+    }
+    return 0;
+}
+
+// 1 when a ranks below b, ties go to memory and then the path so idle cgroups keep their places
+static int cg_less(const Cgroup *a, const Cgroup *b) {
+    if (a->cpu != b->cpu) {
+        return a->cpu < b->cpu;
+    }
+    if (a->mem_current != b->mem_current) {
+        return a->mem_current < b->mem_current;
+    }
+    return strcmp(a->path, b->path) > 0;
+}
+
+// Keeps the top_n busiest in a min-heap, like the process panel does
+static void top_push(CgroupTable *t, Cgroup *c) {
+    Cgroup **h = t->top;
+    int i;
+    if (t->ntop < t->top_n) {
+        i = t->ntop++;
+        while (i > 0 && cg_less(c, h[(i - 1) / 2])) { //Sift up
+            h[i] = h[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        h[i] = c;
+        return;
+    }
+    if (t->ntop == 0 || !cg_less(h[0], c)) {
+        return;
+    }
+    i = 0;
+    for (;;) { //Sift down from the root, which c replaces
+        int k = 2 * i + 1;
+        if (k >= t->ntop) {
+            break;
+        }
+        if (k + 1 < t->ntop && cg_less(h[k + 1], h[k])) {
+            k++;
+        }
+        if (!cg_less(h[k], c)) {
+            break;
+        }
+        h[i] = h[k];
+        i = k;
+    }
+    h[i] = c;
+}
+
+// qsort order, busiest first
+static int by_cpu(const void *a, const void *b) {
+    const Cgroup *x = *(Cgroup *const *)a, *y = *(Cgroup *const *)b;
+    return cg_less(x, y) ? 1 : cg_less(y, x) ? -1 : 0;
+}
+
+// Walks the subtree if it changed, then re-reads every cgroup and picks the busiest.
+// ts_ns 0 only sets the baseline
+int cgroup_read(CgroupTable *t, long long ts_ns) {
+    double dt = t->last_ns > 0 && ts_ns > t->last_ns ? (ts_ns - t->last_ns) / 1e9 : 0;
+    t->last_ns = ts_ns;
+    int full = ts_ns - t->walk_ns >= CGROUP_RESCAN_NS; //Also catches a cgroup replaced by another within one tick
+    if (full) {
+        t->walk_ns = ts_ns;
+    }
+    if (t->subtree && t->root_stat_fd != -1) {
+        char buf[128];
+        unsigned long long n = 0;
+        ssize_t len = pread(t->root_stat_fd, buf, sizeof(buf) - 1, 0);
+        if (len > 0) {
+            buf[len] = '\0';
+            n = cg_field(buf, "nr_descendants");
+        }
+        if (full || n != t->top_cg->descendants) {
+            t->top_cg->descendants = n;
+            t->walk++;
+            t->walked = 0;
+            t->top_cg->seen = t->walk;
+            cg_walk(t, t->top_cg, full);
+        }
+    }
+
+    t->ntop = 0;
+    for (size_t i = 0; i < t->cap; i++) {
+        Cgroup *c = t->slot[i];
+        if (c == NULL || c == CGROUP_DELETED) {
+            continue;
+        }
+        if (full) {
+            cg_limits(c);
+        }
+        if ((full && t->subtree && c->seen != t->walk) || cg_sample(c, dt, t->ncpus) == -1) {
+            if (c == t->top_cg) {
+                fprintf(stderr, "the cgroup %s went away\n", c->path);
+                return -1;
+            }
+            cg_close(c); //Removed
+            t->slot[i] = CGROUP_DELETED;
+            t->used--;
+            t->deleted++;
+            continue;
+        }
+        top_push(t, c);
+    }
+    qsort(t->top, t->ntop, sizeof(Cgroup *), by_cpu);
+    return 0;
+}
+
+// Collector wrapper for the scheduler
+void cgroup_collect(void *ctx, long long ts_ns) {
+    cgroup_read(ctx, ts_ns);
+}
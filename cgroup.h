@@ -0,0 +1,56 @@
+#ifndef CGROUP_H
+#define CGROUP_H
+
+#include <limits.h>
+
+#define CGROUP_PATH 256
+#define CGROUP_RESCAN_NS 10000000000LL // a full walk and a re-read of the limits at most this far apart
+
+// One cgroup v2 directory. Its directory and its two hot files stay open, so a read is two
+// preads. memory.max and cpu.max change rarely and are re-read with every full walk
+typedef struct Cgroup {
+    char path[CGROUP_PATH];  // relative to the cgroup2 mount, "/" for the mount itself
+    int dirfd;
+    int stat_fd;             // cpu.stat, -1 when the process ran out of fds: then opened every read
+    int mem_fd;              // memory.current, likewise
+    int has_mem;             // 0 without the memory controller, e.g. the root cgroup
+    unsigned long long descendants; // nr_descendants at the last walk, a walk skips it while unchanged
+    unsigned long long usage_usec, nr_periods, nr_throttled, throttled_usec;
+    unsigned long long mem_current, mem_max; // bytes, mem_max 0 without a limit
+    float quota;             // cpus that cpu.max allows, 0 without a limit
+    float cpu;               // % of the quota, or of every cpu without one
+    float throttled;         // % of the enforcement periods in which it was throttled
+    float throttled_ms;      // ms throttled per second
+    int fresh;               // no delta yet
+    unsigned long long seen; // walk that last found it
+} Cgroup;
+
+// One cgroup, or every cgroup below one. The subtree is walked again only when its root's
+// nr_descendants changed, and then only into directories whose own count changed, so a
+// steady tree of thousands of cgroups costs one extra pread per tick
+typedef struct {
+    char root[PATH_MAX];     // absolute path of the cgroup2 mount, under --proc-root
+    int subtree;             // 0 only reads the given cgroup
+    Cgroup **slot;           // open addressing on the path, NULL is empty
+    size_t cap;
+    size_t used;
+    size_t deleted;
+    Cgroup *top_cg;          // the cgroup that was given
+    int root_stat_fd;        // its cgroup.stat, re-read every tick to notice changes below it
+    Cgroup **top;            // the top_n busiest after a read, busiest first
+    int top_n;
+    int ntop;
+    int ncpus;
+    long long last_ns;
+    long long walk_ns;       // when the last full walk ran
+    unsigned long long walk; // walks so far
+    unsigned long walked;    // directories listed by the last walk
+    unsigned long skipped;   // cgroups that could not be opened
+} CgroupTable;
+
+int cgroup_init(CgroupTable *t, const char *path, int subtree, int top_n);
+int cgroup_read(CgroupTable *t, long long ts_ns);
+void cgroup_collect(void *ctx, long long ts_ns);
+void cgroup_free(CgroupTable *t);
+
+#endif
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fnmatch.h>
+#include "disk.h"
+
+// 1 when name passes the filter: it matches one of the plain patterns (or there are none)
+// and none of the '!' ones
+static int disk_match(const char *filter, const char *name) {
+    int includes = 0, included = 0;
+    const char *p = filter;
+    while (p != NULL && *p != '\0') {
+        const char *comma = strchr(p, ',');
+        size_t len = comma != NULL ? (size_t)(comma - p) : strlen(p);
+        char pattern[64];
+        if (len >= sizeof(pattern)) {
+            len = sizeof(pattern) - 1;
+        }
+        memcpy(pattern, p, len);
+        pattern[len] = '\0';
+        if (pattern[0] == '!') {
+            if (fnmatch(pattern + 1, name, 0) == 0) {
+                return 0;
+            }
+        }
+        else if (len > 0) {
+            includes = 1;
+            if (fnmatch(pattern, name, 0) == 0) {
+                included = 1;
+            }
+        }
+        p = comma != NULL ? comma + 1 : NULL;
+    }
+    return !includes || included;
+}
+
+int disk_init(DiskTable *t, const char *filter) {
+    memset(t, 0, sizeof(*t));
+    t->filter = filter != NULL ? filter : DISK_DEFAULT_FILTER;
+    char path[PATH_MAX];
+    if (proc_open(&t->file, proc_path("/proc/diskstats", path)) == -1) {
+        perror("unable to open /proc/diskstats");
+        return -1;
+    }
+    return disk_read(t, 0);
+}
+
+void disk_free(DiskTable *t) {
+    proc_close(&t->file);
+    free(t->dev);
+    t->dev = NULL;
+    t->ndev = t->cap = t->nshown = 0;
+}
+
+// A counter that went backwards belongs to a device re-created under the same name, e.g. dm or nbd
+static unsigned long long delta(unsigned long long now, unsigned long long before) {
+    return now >= before ? now - before : 0;
+}
+
+static float rate(unsigned long long now, unsigned long long before, double dt) {
+    return delta(now, before) / dt;
+}
+
+// Re-reads /proc/diskstats and updates the rates of the shown devices, ts_ns 0 only sets the baseline
+int disk_read(DiskTable *t, long long ts_ns) {
+    if (proc_read(&t->file) == -1) {
+        perror("unable to read /proc/diskstats");
+        return -1;
+    }
+    double dt = t->last_ns > 0 && ts_ns > t->last_ns ? (ts_ns - t->last_ns) / 1e9 : 0;
+    t->last_ns = ts_ns;
+
+    const char *p = t->file.buf;
+    const char *end = p + t->file.len;
+    int i = 0;
+    while (p < end) {
+        const char *nl = memchr(p, '\n', end - p);
+        if (nl == NULL) {
+            nl = end;
+        }
+        const char *q = p;
+        scan_u64(&q); //major
+        scan_u64(&q); //minor
+        while (*q == ' ') {
+            q++;
+        }
+        const char *name = q;
+        while (q < nl && *q != ' ') {
+            q++;
+        }
+        size_t len = q - name;
+        if (len == 0) {
+            p = nl + 1;
+            continue;
+        }
+        if (len >= DISK_NAME) {
+            len = DISK_NAME - 1;
+        }
+
+        if (i == t->cap) { //Only when devices are added
+            int cap = t->cap > 0 ? t->cap * 2 : 64;
+            DiskDev *bigger = realloc(t->dev, cap * sizeof(DiskDev));
+            if (bigger == NULL) {
+                perror("realloc error, unable to grow the disk table");
+                return -1;
+            }
+            t->dev = bigger;
+            t->cap = cap;
+        }
+        DiskDev *d = &t->dev[i++];
+        if (i > t->ndev || memcmp(d->name, name, len) != 0 || d->name[len] != '\0') {
+            memset(d, 0, sizeof(*d)); //A device was added or removed before this line
+            memcpy(d->name, name, len);
+            d->shown = disk_match(t->filter, d->name);
+            d->fresh = 1;
+        }
+        if (!d->shown) {
+            p = nl + 1;
+            continue;
+        }
+
+        unsigned long long reads = scan_u64(&q);
+        scan_u64(&q); //reads merged
+        unsigned long long sectors_read = scan_u64(&q);
+        unsigned long long ms_reading = scan_u64(&q);
+        unsigned long long writes = scan_u64(&q);
+        scan_u64(&q); //writes merged
+        unsigned long long sectors_written = scan_u64(&q);
+        unsigned long long ms_writing = scan_u64(&q);
+        scan_u64(&q); //in flight right now
+        unsigned long long ms_io = scan_u64(&q);
+        unsigned long long ms_weighted = scan_u64(&q);
+
+        if (!d->fresh && dt > 0) {
+            unsigned long long ios = delta(reads, d->reads) + delta(writes, d->writes);
+            d->read_bps = rate(sectors_read, d->sectors_read, dt) * 512;
+            d->write_bps = rate(sectors_written, d->sectors_written, dt) * 512;
+            d->iops = ios / dt;
+            d->await_ms = ios > 0 ? (float)(delta(ms_reading, d->ms_reading) + delta(ms_writing, d->ms_writing)) / ios : 0;
+            d->queue = rate(ms_weighted, d->ms_weighted, dt) / 1000;
+            d->util = rate(ms_io, d->ms_io, dt) / 10; //ms per second, as a %
+        }
+        d->fresh = 0;
+        d->reads = reads;
+        d->writes = writes;
+        d->sectors_read = sectors_read;
+        d->sectors_written = sectors_written;
+        d->ms_reading = ms_reading;
+        d->ms_writing = ms_writing;
+        d->ms_io = ms_io;
+        d->ms_weighted = ms_weighted;
+        p = nl + 1;
+    }
+    t->ndev = i;
+    t->nshown = 0;
+    for (int k = 0; k < t->ndev; k++) {
+        t->nshown += t->dev[k].shown;
+    }
+    return 0;
+}
+
+// Collector wrapper for the scheduler
+void disk_collect(void *ctx, long long ts_ns) {
+    disk_read(ctx, ts_ns);
+}
@@ -0,0 +1,43 @@
+#ifndef DISK_H
+#define DISK_H
+
+#include "sampler.h"
+
+#define DISK_NAME 32
+#define DISK_DEFAULT_FILTER "!loop*,!ram*,!zram*,!fd*,!sr*"
+
+// One line of /proc/diskstats, the counters are from the last read
+typedef struct {
+    char name[DISK_NAME];
+    int shown;       // matched the filter
+    int fresh;       // appeared in the last read, so there is no delta yet
+    unsigned long long reads, writes;
+    unsigned long long sectors_read, sectors_written; // 512 bytes each, whatever the device's sector size
+    unsigned long long ms_reading, ms_writing;
+    unsigned long long ms_io;       // time with I/O in flight
+    unsigned long long ms_weighted; // time with I/O in flight, weighted by how many
+    float read_bps, write_bps;
+    float iops;
+    float await_ms;  // average time per completed request, queueing included
+    float queue;     // average requests in flight
+    float util;      // % of the interval with I/O in flight
+} DiskDev;
+
+// Every device in /proc/diskstats, in file order. While the device list stays the same
+// each read only compares names and parses the lines of the shown devices
+typedef struct {
+    ProcFile file;
+    DiskDev *dev;
+    int ndev;
+    int cap;
+    int nshown;
+    const char *filter; // comma separated fnmatch patterns, a leading '!' excludes
+    long long last_ns;
+} DiskTable;
+
+int disk_init(DiskTable *t, const char *filter);
+int disk_read(DiskTable *t, long long ts_ns);
+void disk_collect(void *ctx, long long ts_ns);
+void disk_free(DiskTable *t);
+
+#endif
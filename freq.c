@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include "freq.h"
+
+int freq_init(FreqTable *t, int ncpus) {
+    memset(t, 0, sizeof(*t));
+    t->cpuinfo = (ProcFile)PROC_FILE_INIT;
+    t->fd = malloc(ncpus * sizeof(int));
+    t->ghz = calloc(ncpus, sizeof(float));
+    if (t->fd == NULL || t->ghz == NULL) {
+        perror("malloc error, unable to allocate the frequency table");
+        return -1;
+    }
+    t->n = ncpus;
+    int opened = 0;
+    for (int i = 0; i < ncpus; i++) {
+        char name[64], path[PATH_MAX];
+        snprintf(name, sizeof(name), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", i);
+        t->fd[i] = open(proc_path(name, path), O_RDONLY | O_CLOEXEC);
+        opened += t->fd[i] != -1;
+    }
+    if (opened > 0) {
+        t->source = FREQ_SYSFS;
+    }
+    else {
+        char path[PATH_MAX];
+        if (proc_open(&t->cpuinfo, proc_path("/proc/cpuinfo", path)) == 0) {
+            t->source = FREQ_CPUINFO;
+        }
+    }
+    if (freq_read(t) == -1) {
+        return -1;
+    }
+    if (t->source == FREQ_CPUINFO) {
+        int known = 0;
+        for (int i = 0; i < t->n; i++) {
+            known += t->ghz[i] > 0;
+        }
+        if (known == 0) { //No "cpu MHz" lines, e.g. on most ARM hosts
+            proc_close(&t->cpuinfo);
+            t->source = FREQ_NONE;
+        }
+    }
+    return 0;
+}
+
+void freq_free(FreqTable *t) {
+    if (t->fd != NULL) {
+        for (int i = 0; i < t->n; i++) {
+            if (t->fd[i] != -1) {
+                close(t->fd[i]);
+            }
+        }
+    }
+    free(t->fd);
+    free(t->ghz);
+    proc_close(&t->cpuinfo);
+    t->fd = NULL;
+    t->ghz = NULL;
+    t->n = 0;
+    t->source = FREQ_NONE;
+}
+
+// One pread per cpu, the files only hold a number of kHz
+static void read_sysfs(FreqTable *t) {
+    for (int i = 0; i < t->n; i++) {
+        if (t->fd[i] == -1) {
+            continue; //An offline cpu or one without a driver
+        }
+        char buf[32];
+        ssize_t len = pread(t->fd[i], buf, sizeof(buf) - 1, 0);
+        if (len <= 0) {
+            t->ghz[i] = 0;
+            continue;
+        }
+        buf[len] = '\0';
+        const char *p = buf;
+        t->ghz[i] = scan_u64(&p) / 1000000.0f; // kHz → GHz
+    }
+}
+
+// The "cpu MHz" line of each processor entry. On x86 reading cpuinfo asks every cpu for its
+// clock, so this is much slower than sysfs and only used when there is no cpufreq
+static int read_cpuinfo(FreqTable *t) {
+    if (proc_read(&t->cpuinfo) == -1) {
+        perror("unable to read /proc/cpuinfo");
+        return -1;
+    }
+    const char *p = t->cpuinfo.buf;
+    const char *end = p + t->cpuinfo.len;
+    int cpu = -1;
+    while (p < end) {
+        const char *nl = memchr(p, '\n', end - p);
+        if (nl == NULL) {
+            nl = end;
+        }
+        const char *colon = memchr(p, ':', nl - p);
+        if (colon != NULL && strncmp(p, "processor", 9) == 0) {
+            const char *q = colon + 1;
+            cpu = scan_u64(&q);
+        }
+        else if (colon != NULL && strncmp(p, "cpu MHz", 7) == 0 && cpu >= 0 && cpu < t->n) {
+            const char *q = colon + 1;
+            unsigned long long mhz = scan_u64(&q);
+            unsigned long long frac = 0, scale = 1;
+            if (*q == '.') {
+                q++;
+                const char *digits = q;
+                frac = scan_u64(&q);
+                for (long k = q - digits; k > 0; k--) {
+                    scale *= 10;
+                }
+            }
+            t->ghz[cpu] = (mhz + (float)frac / scale) / 1000.0f;
+        }
+        p = nl + 1;
+    }
+    return 0;
+}
+
+// Re-reads the clock of every cpu, nothing to do without a source
+int freq_read(FreqTable *t) {
+    if (t->source == FREQ_SYSFS) {
+        read_sysfs(t);
+    }
+    else if (t->source == FREQ_CPUINFO) {
+        return read_cpuinfo(t);
+    }
+    return 0;
+}
+
+// Collector wrapper for the scheduler
+void freq_collect(void *ctx, long long ts_ns) {
+    freq_read(ctx);
+}
@@ -0,0 +1,25 @@
+#ifndef FREQ_H
+#define FREQ_H
+
+#include "sampler.h"
+
+#define FREQ_NONE 0    // neither source is available, e.g. a VM without cpufreq
+#define FREQ_SYSFS 1   // cpuN/cpufreq/scaling_cur_freq
+#define FREQ_CPUINFO 2 // the "cpu MHz" lines of /proc/cpuinfo
+
+// The current clock of every cpu. With cpufreq each cpu's scaling_cur_freq is opened once
+// and re-read with one pread into a small stack buffer, so a read never allocates
+typedef struct {
+    int source;
+    int n;
+    int *fd;          // scaling_cur_freq of cpu i, -1 when that cpu has none
+    float *ghz;       // from the last read, 0 when unknown
+    ProcFile cpuinfo; // only opened for FREQ_CPUINFO
+} FreqTable;
+
+int freq_init(FreqTable *t, int ncpus);
+int freq_read(FreqTable *t);
+void freq_collect(void *ctx, long long ts_ns);
+void freq_free(FreqTable *t);
+
+#endif
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "history.h"
+
+static int history_map(History *h, size_t size, int prot) {
+    void *map = mmap(NULL, size, prot, MAP_SHARED, h->fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap error, unable to map the history file");
+        close(h->fd);
+        h->fd = -1;
+        return -1;
+    }
+    h->map_size = size;
+    h->hdr = map;
+    h->records = (char *)map + sizeof(HistoryHeader);
+    return 0;
+}
+
+// Size of one record holding ncores per-core values, 8-byte aligned so ts_ns is too
+uint32_t history_record_size(int ncores) {
+    return (SAMPLE_HEAD_SIZE + ncores * sizeof(float) + 7) & ~7u;
+}
+
+// Lays out one record: the Sample head, ncores per-core values, zero padding up to record_size
+void history_pack(char *rec, const Sample *s, int ncores, uint32_t record_size) {
+    size_t n = s->ncores < ncores ? s->ncores : ncores;
+    memcpy(rec, s, SAMPLE_HEAD_SIZE);
+    memcpy(rec + SAMPLE_HEAD_SIZE, s->core, n * sizeof(float));
+    memset(rec + SAMPLE_HEAD_SIZE + n * sizeof(float), 0, record_size - SAMPLE_HEAD_SIZE - n * sizeof(float));
+}
+
+// Opens path for recording. A file written earlier with the same layout is appended to,
+// anything else is replaced with an empty ring of at most max_bytes
+int history_create(History *h, const char *path, int ncores, size_t max_bytes) {
+    memset(h, 0, sizeof(*h));
+    h->writable = 1;
+    uint32_t record_size = history_record_size(ncores);
+
+    h->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (h->fd == -1) {
+        perror("open error, unable to open the record file");
+        return -1;
+    }
+
+    HistoryHeader hdr;
+    struct stat st;
+    if (fstat(h->fd, &st) == 0 && pread(h->fd, &hdr, sizeof(hdr), 0) == sizeof(hdr)
+        && memcmp(hdr.magic, HISTORY_MAGIC, 8) == 0 && hdr.version == HISTORY_VERSION
+        && hdr.head_size == SAMPLE_HEAD_SIZE && hdr.ncores == (uint32_t)ncores && hdr.record_size == record_size
+        && (uint64_t)st.st_size == sizeof(hdr) + hdr.capacity * record_size) {
+        return history_map(h, st.st_size, PROT_READ | PROT_WRITE); //Same layout, keep appending to the ring
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, HISTORY_MAGIC, 8);
+    hdr.version = HISTORY_VERSION;
+    hdr.head_size = SAMPLE_HEAD_SIZE;
+    hdr.ncores = ncores;
+    hdr.record_size = record_size;
+    hdr.capacity = max_bytes > sizeof(hdr) + record_size ? (max_bytes - sizeof(hdr)) / record_size : 1;
+
+    size_t size = sizeof(hdr) + hdr.capacity * record_size;
+    if (ftruncate(h->fd, 0) == -1 || ftruncate(h->fd, size) == -1) { //Sparse until the ring fills up
+        perror("ftruncate error, unable to size the record file");
+        close(h->fd);
+        h->fd = -1;
+        return -1;
+    }
+    if (history_map(h, size, PROT_READ | PROT_WRITE) == -1) {
+        return -1;
+    }
+    *h->hdr = hdr;
+    return 0;
+}
+
+// Opens a recording read-only for replay
+int history_open(History *h, const char *path) {
+    memset(h, 0, sizeof(*h));
+    h->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (h->fd == -1) {
+        perror("open error, unable to open the replay file");
+        return -1;
+    }
+    HistoryHeader hdr;
+    struct stat st;
+    if (fstat(h->fd, &st) == -1 || pread(h->fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)
+        || memcmp(hdr.magic, HISTORY_MAGIC, 8) != 0 || hdr.version != HISTORY_VERSION) {
+        fprintf(stderr, "%s is not a sysmon recording\n", path);
+        close(h->fd);
+        h->fd = -1;
+        return -1;
+    }
+    uint64_t bytes;
+    if (hdr.head_size < sizeof(long long) || hdr.ncores > MAX_CORES || hdr.capacity == 0
+        || hdr.record_size < hdr.head_size + (uint64_t)hdr.ncores * sizeof(float) //Every record holds what unpack reads
+        || __builtin_mul_overflow(hdr.capacity, (uint64_t)hdr.record_size, &bytes)
+        || bytes > UINT64_MAX - sizeof(hdr) || (uint64_t)st.st_size < sizeof(hdr) + bytes) {
+        fprintf(stderr, "%s is a damaged sysmon recording, its header does not match its size\n", path);
+        close(h->fd);
+        h->fd = -1;
+        return -1;
+    }
+    return history_map(h, st.st_size, PROT_READ);
+}
+
+// Copies the sample into the next slot of the ring, overwriting the oldest record once it is full
+void history_append(History *h, const Sample *s) {
+    HistoryHeader *hdr = h->hdr;
+    char *rec = h->records + (hdr->written % hdr->capacity) * hdr->record_size;
+    history_pack(rec, s, hdr->ncores, hdr->record_size);
+    hdr->written++;
+}
+
+uint64_t history_count(const History *h) {
+    return h->hdr->written < h->hdr->capacity ? h->hdr->written : h->hdr->capacity;
+}
+
+// Reads the i-th oldest record still in the ring
+void history_get(const History *h, uint64_t i, Sample *s) {
+    const HistoryHeader *hdr = h->hdr;
+    uint64_t oldest = hdr->written > hdr->capacity ? hdr->written - hdr->capacity : 0;
+    history_unpack(s, h->records + ((oldest + i) % hdr->capacity) * hdr->record_size, hdr);
+}
+
+// Reads one record laid out as hdr describes, which may be an older or newer layout than ours
+void history_unpack(Sample *s, const char *rec, const HistoryHeader *hdr) {
+    size_t head = hdr->head_size < SAMPLE_HEAD_SIZE ? hdr->head_size : SAMPLE_HEAD_SIZE; //Older files have a shorter head
+    int ncores = hdr->ncores < MAX_CORES ? hdr->ncores : MAX_CORES;
+
+    memset(s, 0, SAMPLE_HEAD_SIZE);
+    memcpy(s, rec, head);
+    s->ncores = ncores;
+    memcpy(s->core, rec + hdr->head_size, ncores * sizeof(float));
+}
+
+void history_close(History *h) {
+    if (h->hdr != NULL) {
+        if (h->writable) {
+            msync(h->hdr, h->map_size, MS_ASYNC);
+        }
+        munmap(h->hdr, h->map_size);
+    }
+    if (h->fd != -1) {
+        close(h->fd);
+    }
+    h->hdr = NULL;
+    h->fd = -1;
+}
@@ -0,0 +1,42 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include "sample.h"
+
+#define HISTORY_MAGIC "SYSMONR1"
+#define HISTORY_VERSION 1
+
+// Start of a history file, followed by capacity fixed-size records:
+// the Sample head (head_size bytes) and then ncores per-core floats
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t head_size;
+    uint32_t ncores;
+    uint32_t record_size;
+    uint64_t capacity;
+    uint64_t written; //records ever appended, the next one goes to slot written % capacity
+    char pad[24];
+} HistoryHeader;
+
+// A bounded ring of samples in an mmap'd file
+typedef struct {
+    int fd;
+    int writable;
+    HistoryHeader *hdr;
+    char *records;
+    size_t map_size;
+} History;
+
+uint32_t history_record_size(int ncores);
+void history_pack(char *rec, const Sample *s, int ncores, uint32_t record_size);
+int history_create(History *h, const char *path, int ncores, size_t max_bytes);
+int history_open(History *h, const char *path);
+void history_append(History *h, const Sample *s);
+uint64_t history_count(const History *h);
+void history_get(const History *h, uint64_t i, Sample *s);
+void history_unpack(Sample *s, const char *rec, const HistoryHeader *hdr);
+void history_close(History *h);
+
+#endif
@@ -0,0 +1,60 @@
+#include <string.h>
+#include "kstat.h"
+
+const char *kstat_names[KSTAT_SERIES] = {
+    "ctxt/s", "intr/s", "softirq/s", "forks/s", "running", "blocked", "pgfault/s", "majflt/s", "pswpin/s", "pswpout/s",
+};
+
+static int kstat_gauge(int i) {
+    return i == KSTAT_RUNNING || i == KSTAT_BLOCKED;
+}
+
+// Takes the counters of s and reads /proc/vmstat
+void kstat_update(KernelStats *k, const StatSample *s, long long ts_ns) {
+    k->now[KSTAT_CTXT] = s->ctxt;
+    k->now[KSTAT_INTR] = s->intr;
+    k->now[KSTAT_SOFTIRQ] = s->softirq;
+    k->now[KSTAT_FORKS] = s->processes;
+    k->now[KSTAT_RUNNING] = s->procs_running;
+    k->now[KSTAT_BLOCKED] = s->procs_blocked;
+    VmStat v;
+    if (k->has_vmstat && vmstat_read(&v) == 0) {
+        k->now[KSTAT_PGFAULT] = v.pgfault;
+        k->now[KSTAT_MAJFAULT] = v.pgmajfault;
+        k->now[KSTAT_SWAPIN] = v.pswpin;
+        k->now[KSTAT_SWAPOUT] = v.pswpout;
+    }
+    k->now_ns = ts_ns;
+}
+
+// Baseline from a /proc/stat read, so the first rates already have a delta
+void kstat_init(KernelStats *k, const StatSample *s, long long ts_ns) {
+    memset(k, 0, sizeof(*k));
+    k->has_vmstat = 1;
+    VmStat v;
+    if (vmstat_read(&v) == -1) {
+        k->has_vmstat = 0; //Only the /proc/stat series then
+    }
+    kstat_update(k, s, ts_ns);
+    memcpy(k->last, k->now, sizeof(k->last));
+    k->last_ns = ts_ns;
+}
+
+// Rates since the previous call. Without a new update in between the rates are kept, e.g. for a
+// sample that spans several columns
+void kstat_rates(KernelStats *k) {
+    long long elapsed = k->now_ns - k->last_ns;
+    if (elapsed <= 0) {
+        return;
+    }
+    for (int i = 0; i < KSTAT_SERIES; i++) {
+        if (kstat_gauge(i)) {
+            k->rate[i] = k->now[i];
+        }
+        else {
+            k->rate[i] = k->now[i] >= k->last[i] ? (k->now[i] - k->last[i]) * 1e9 / elapsed : 0; //A counter that went back was reset
+        }
+    }
+    memcpy(k->last, k->now, sizeof(k->last));
+    k->last_ns = k->now_ns;
+}
@@ -0,0 +1,36 @@
+#ifndef KSTAT_H
+#define KSTAT_H
+
+#include "sampler.h"
+
+#define KSTAT_CTXT 0
+#define KSTAT_INTR 1
+#define KSTAT_SOFTIRQ 2
+#define KSTAT_FORKS 3
+#define KSTAT_RUNNING 4
+#define KSTAT_BLOCKED 5
+#define KSTAT_PGFAULT 6
+#define KSTAT_MAJFAULT 7
+#define KSTAT_SWAPIN 8
+#define KSTAT_SWAPOUT 9
+#define KSTAT_SERIES 10
+#define KSTAT_FIRST_VM KSTAT_PGFAULT // the series from /proc/vmstat, the ones before are from /proc/stat
+
+// Kernel activity counters. The /proc/stat ones come from the read the cpu collector already
+// made, only /proc/vmstat costs a pread of its own. Rates are taken between two kstat_rates
+// calls, so a graph column covers every sample taken for it
+typedef struct {
+    unsigned long long now[KSTAT_SERIES];  // at the latest update
+    unsigned long long last[KSTAT_SERIES]; // at the previous kstat_rates
+    long long now_ns, last_ns;
+    float rate[KSTAT_SERIES];  // per second, except running and blocked which are how many right now
+    int has_vmstat;            // 0 when /proc/vmstat could not be read, its series stay 0
+} KernelStats;
+
+extern const char *kstat_names[KSTAT_SERIES];
+
+void kstat_init(KernelStats *k, const StatSample *s, long long ts_ns);
+void kstat_update(KernelStats *k, const StatSample *s, long long ts_ns);
+void kstat_rates(KernelStats *k);
+
+#endif
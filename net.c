@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "net.h"
+
+int net_init(NetTable *t) {
+    memset(t, 0, sizeof(*t));
+    char path[PATH_MAX];
+    if (proc_open(&t->file, proc_path("/proc/net/dev", path)) == -1) {
+        perror("unable to open /proc/net/dev");
+        return -1;
+    }
+    return net_read(t, 0);
+}
+
+void net_free(NetTable *t) {
+    proc_close(&t->file);
+    free(t->iface);
+    t->iface = NULL;
+    t->n = t->cap = 0;
+}
+
+static float rate(unsigned long long now, unsigned long long before, double dt) {
+    return now >= before ? (now - before) / dt : 0;
+}
+
+// Re-reads /proc/net/dev and updates the per-interface rates, ts_ns 0 only sets the baseline
+int net_read(NetTable *t, long long ts_ns) {
+    if (proc_read(&t->file) == -1) {
+        perror("unable to read /proc/net/dev");
+        return -1;
+    }
+    double dt = t->last_ns > 0 && ts_ns > t->last_ns ? (ts_ns - t->last_ns) / 1e9 : 0;
+    t->last_ns = ts_ns;
+    t->rx_bps = t->tx_bps = 0;
+
+    const char *p = t->file.buf;
+    const char *end = p + t->file.len;
+    int i = 0;
+    while (p < end) {
+        const char *nl = memchr(p, '\n', end - p);
+        if (nl == NULL) {
+            nl = end;
+        }
+        const char *colon = memchr(p, ':', nl - p);
+        if (colon == NULL) {
+            p = nl + 1; //One of the two header lines
+            continue;
+        }
+        const char *name = p;
+        while (*name == ' ') {
+            name++;
+        }
+        size_t len = colon - name;
+        if (len >= NET_NAME) {
+            len = NET_NAME - 1;
+        }
+        if (i == t->cap) { //Only when interfaces are added, hosts with many veths go past any fixed size
+            int cap = t->cap > 0 ? t->cap * 2 : 64;
+            NetIface *bigger = realloc(t->iface, cap * sizeof(NetIface));
+            if (bigger == NULL) {
+                perror("realloc error, unable to grow the interface table");
+                return -1;
+            }
+            t->iface = bigger;
+            t->cap = cap;
+        }
+        NetIface *f = &t->iface[i++];
+        if (i > t->n || memcmp(f->name, name, len) != 0 || f->name[len] != '\0') {
+            memset(f, 0, sizeof(*f)); //An interface was added or removed before this line
+            memcpy(f->name, name, len);
+            f->fresh = 1;
+        }
+
+        const char *q = colon + 1;
+        unsigned long long rx_bytes = scan_u64(&q);
+        unsigned long long rx_packets = scan_u64(&q);
+        scan_u64(&q); //errs
+        unsigned long long rx_drop = scan_u64(&q);
+        scan_u64(&q); //fifo
+        scan_u64(&q); //frame
+        scan_u64(&q); //compressed
+        scan_u64(&q); //multicast
+        unsigned long long tx_bytes = scan_u64(&q);
+        unsigned long long tx_packets = scan_u64(&q);
+        scan_u64(&q); //errs
+        unsigned long long tx_drop = scan_u64(&q);
+
+        if (!f->fresh && dt > 0) {
+            f->rx_bps = rate(rx_bytes, f->rx_bytes, dt);
+            f->rx_pps = rate(rx_packets, f->rx_packets, dt);
+            f->rx_dps = rate(rx_drop, f->rx_drop, dt);
+            f->tx_bps = rate(tx_bytes, f->tx_bytes, dt);
+            f->tx_pps = rate(tx_packets, f->tx_packets, dt);
+            f->tx_dps = rate(tx_drop, f->tx_drop, dt);
+        }
+        f->fresh = 0;
+        f->rx_bytes = rx_bytes;
+        f->rx_packets = rx_packets;
+        f->rx_drop = rx_drop;
+        f->tx_bytes = tx_bytes;
+        f->tx_packets = tx_packets;
+        f->tx_drop = tx_drop;
+        if (strcmp(f->name, "lo") != 0) { //Loopback traffic never leaves the machine
+            t->rx_bps += f->rx_bps;
+            t->tx_bps += f->tx_bps;
+        }
+        p = nl + 1;
+    }
+    t->n = i;
+    return 0;
+}
+
+// Collector wrapper for the scheduler
+void net_collect(void *ctx, long long ts_ns) {
+    net_read(ctx, ts_ns);
+}
@@ -0,0 +1,34 @@
+#ifndef NET_H
+#define NET_H
+
+#include "sampler.h"
+
+#define NET_NAME 16
+
+// One interface of /proc/net/dev, the counters are from the last read
+typedef struct {
+    char name[NET_NAME];
+    int fresh; // appeared in the last read, so there is no delta yet
+    unsigned long long rx_bytes, rx_packets, rx_drop;
+    unsigned long long tx_bytes, tx_packets, tx_drop;
+    float rx_bps, rx_pps, rx_dps;
+    float tx_bps, tx_pps, tx_dps; // bytes, packets and drops per second
+} NetIface;
+
+// Every interface in file order, in a fixed table that is only rewritten from the first line
+// that changed when interfaces come or go, so reading it never allocates
+typedef struct {
+    ProcFile file;
+    NetIface *iface;       // every interface, in the order of the file
+    int n;
+    int cap;
+    float rx_bps, tx_bps; // sum over every interface but lo
+    long long last_ns;
+} NetTable;
+
+int net_init(NetTable *t);
+int net_read(NetTable *t, long long ts_ns);
+void net_collect(void *ctx, long long ts_ns);
+void net_free(NetTable *t);
+
+#endif
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "output.h"
+#include "history.h"
+#include "sched.h"
+
+#define RECORD_MAX_TEXT (640 + MAX_CORES * 12) // longest text record: a label, the head plus "100.00," per core
+
+// Memory columns after mem_total, in Sample order
+static const struct {
+    const char *name;
+    size_t off;
+} mem_columns[] = {
+    { "mem_available_gb", offsetof(Sample, mem_available) },
+    { "mem_cached_gb", offsetof(Sample, mem_cached) },
+    { "mem_buffers_gb", offsetof(Sample, mem_buffers) },
+    { "mem_dirty_gb", offsetof(Sample, mem_dirty) },
+    { "mem_shmem_gb", offsetof(Sample, mem_shmem) },
+    { "swap_total_gb", offsetof(Sample, swap_total) },
+    { "swap_used_gb", offsetof(Sample, swap_used) },
+};
+
+#define MEM_COLUMNS (sizeof(mem_columns) / sizeof(mem_columns[0]))
+#define MEM_COLUMN(s, i) (*(const float *)((const char *)(s) + mem_columns[i].off))
+
+int output_format(const char *name) {
+    if (strcmp(name, "csv") == 0) {
+        return FORMAT_CSV;
+    }
+    if (strcmp(name, "jsonl") == 0) {
+        return FORMAT_JSONL;
+    }
+    if (strcmp(name, "bin") == 0) {
+        return FORMAT_BIN;
+    }
+    return -1;
+}
+
+static char *put_str(char *o, const char *s) {
+    size_t len = strlen(s);
+    memcpy(o, s, len);
+    return o + len;
+}
+
+static char *put_u64(char *o, unsigned long long v) {
+    char tmp[20];
+    int n = 0;
+    do {
+        tmp[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v > 0);
+    while (n > 0) {
+        *o++ = tmp[--n];
+    }
+    return o;
+}
+
+// Two decimals without going through printf, the values are percentages and GB
+static char *put_fixed2(char *o, double v) {
+    if (v < 0) {
+        *o++ = '-';
+        v = -v;
+    }
+    unsigned long long hundredths = (unsigned long long)(v * 100 + 0.5);
+    o = put_u64(o, hundredths / 100);
+    *o++ = '.';
+    *o++ = '0' + (hundredths / 10) % 10;
+    *o++ = '0' + hundredths % 10;
+    return o;
+}
+
+static int output_drain(Output *o) {
+    size_t done = 0;
+    while (done < o->len) {
+        ssize_t n = write(o->fd, o->buf + done, o->len - done);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        done += n;
+    }
+    o->len = 0;
+    o->writes++;
+    return 0;
+}
+
+static int output_start(Output *o, const char *path, int format, int ncores, int flush_every, long flush_ms, int labelled) {
+    memset(o, 0, sizeof(*o));
+    o->labelled = labelled;
+    o->format = format;
+    o->ncores = ncores;
+    o->flush_every = flush_every > 0 ? flush_every : 1;
+    o->flush_ns = flush_ms * 1000000LL;
+    o->fd = STDOUT_FILENO;
+    if (path != NULL) {
+        o->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (o->fd == -1) {
+            perror("open error, unable to open the output file");
+            return -1;
+        }
+    }
+    size_t record_max = format == FORMAT_BIN ? history_record_size(ncores) : RECORD_MAX_TEXT;
+    o->cap = record_max * (o->flush_every + 1) + sizeof(HistoryHeader);
+    o->buf = malloc(o->cap);
+    if (o->buf == NULL) {
+        perror("malloc error, unable to allocate the output buffer");
+        return -1;
+    }
+
+    char *p = o->buf;
+    if (format == FORMAT_CSV) {
+        p = put_str(p, labelled ? "agent,ts_ns,cpu,mem_used_gb,mem_total_gb" : "ts_ns,cpu,mem_used_gb,mem_total_gb");
+        for (size_t i = 0; i < MEM_COLUMNS; i++) {
+            *p++ = ',';
+            p = put_str(p, mem_columns[i].name);
+        }
+        for (int i = 0; i < ncores; i++) {
+            p = put_str(p, ",core");
+            p = put_u64(p, i);
+        }
+        *p++ = '\n';
+    }
+    else if (format == FORMAT_BIN) {
+        HistoryHeader hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, STREAM_MAGIC, 8);
+        hdr.version = HISTORY_VERSION;
+        hdr.head_size = SAMPLE_HEAD_SIZE;
+        hdr.ncores = ncores;
+        hdr.record_size = history_record_size(ncores);
+        memcpy(p, &hdr, sizeof(hdr));
+        p += sizeof(hdr);
+    }
+    o->len = p - o->buf;
+    o->last_flush_ns = now_ns();
+    return output_drain(o);
+}
+
+// path NULL writes to stdout. The header (CSV column names or the binary stream header)
+// is written immediately
+int output_open(Output *o, const char *path, int format, int ncores, int flush_every, long flush_ms) {
+    return output_start(o, path, format, ncores, flush_every, flush_ms, 0);
+}
+
+// Records from many sources, each starting with the name of the one it came from.
+// Text formats only, and without per-core values since every source has its own count
+int output_open_labelled(Output *o, const char *path, int format, int flush_every, long flush_ms) {
+    if (format == FORMAT_BIN) {
+        fprintf(stderr, "labelled records are csv or jsonl\n");
+        return -1;
+    }
+    return output_start(o, path, format, 0, flush_every, flush_ms, 1);
+}
+
+// Appends one record to the buffer, the buffer goes out once flush_every records or flush_ns have built up
+int output_write(Output *o, const Sample *s) {
+    return output_write_labelled(o, NULL, s);
+}
+
+// Same, label goes in the leading column of an output opened with output_open_labelled
+int output_write_labelled(Output *o, const char *label, const Sample *s) {
+    char *p = o->buf + o->len;
+    int ncores = s->ncores < o->ncores ? s->ncores : o->ncores;
+
+    if (o->format == FORMAT_BIN) {
+        uint32_t size = history_record_size(o->ncores);
+        history_pack(p, s, o->ncores, size);
+        p += size;
+    }
+    else if (o->format == FORMAT_CSV) {
+        if (o->labelled) {
+            p = put_str(p, label);
+            *p++ = ',';
+        }
+        p = put_u64(p, s->ts_ns);
+        *p++ = ',';
+        p = put_fixed2(p, s->cpu);
+        *p++ = ',';
+        p = put_fixed2(p, s->mem_used);
+        *p++ = ',';
+        p = put_fixed2(p, s->mem_total);
+        for (size_t i = 0; i < MEM_COLUMNS; i++) {
+            *p++ = ',';
+            p = put_fixed2(p, MEM_COLUMN(s, i));
+        }
+        for (int i = 0; i < o->ncores; i++) {
+            *p++ = ',';
+            p = put_fixed2(p, i < ncores ? s->core[i] : 0);
+        }
+        *p++ = '\n';
+    }
+    else {
+        if (o->labelled) {
+            p = put_str(p, "{\"agent\":\"");
+            p = put_str(p, label);
+            p = put_str(p, "\",\"ts_ns\":");
+        }
+        else {
+            p = put_str(p, "{\"ts_ns\":");
+        }
+        p = put_u64(p, s->ts_ns);
+        p = put_str(p, ",\"cpu\":");
+        p = put_fixed2(p, s->cpu);
+        p = put_str(p, ",\"mem_used_gb\":");
+        p = put_fixed2(p, s->mem_used);
+        p = put_str(p, ",\"mem_total_gb\":");
+        p = put_fixed2(p, s->mem_total);
+        for (size_t i = 0; i < MEM_COLUMNS; i++) {
+            p = put_str(p, ",\"");
+            p = put_str(p, mem_columns[i].name);
+            p = put_str(p, "\":");
+            p = put_fixed2(p, MEM_COLUMN(s, i));
+        }
+        if (o->ncores > 0) {
+            p = put_str(p, ",\"cores\":[");
+            for (int i = 0; i < o->ncores; i++) {
+                if (i > 0) {
+                    *p++ = ',';
+                }
+                p = put_fixed2(p, i < ncores ? s->core[i] : 0);
+            }
+            *p++ = ']';
+        }
+        p = put_str(p, "}\n");
+    }
+    o->len = p - o->buf;
+    o->records++;
+    o->pending++;
+
+    if (o->pending >= o->flush_every || (o->flush_ns > 0 && now_ns() - o->last_flush_ns >= o->flush_ns)) {
+        return output_flush(o);
+    }
+    return 0;
+}
+
+int output_flush(Output *o) {
+    o->pending = 0;
+    o->last_flush_ns = now_ns();
+    if (o->len == 0) {
+        return 0;
+    }
+    return output_drain(o);
+}
+
+void output_close(Output *o) {
+    output_flush(o);
+    if (o->fd != STDOUT_FILENO && o->fd != -1) {
+        close(o->fd);
+    }
+    free(o->buf);
+    o->buf = NULL;
+    o->fd = -1;
+}
@@ -0,0 +1,40 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+#include "sample.h"
+
+#define FORMAT_CSV 0
+#define FORMAT_JSONL 1
+#define FORMAT_BIN 2
+
+// The binary stream starts with a HistoryHeader carrying this magic and capacity 0,
+// followed by records laid out exactly like the ones in a --record file
+#define STREAM_MAGIC "SYSMONS1"
+
+// Buffered headless writer, one record per tick and one write() per batch of records
+typedef struct {
+    int fd;
+    int format;
+    int ncores;
+    int labelled; // records start with the name of their source
+    char *buf;
+    size_t cap;
+    size_t len;
+    int flush_every; //records per write
+    long long flush_ns; //or this long since the last write, whichever comes first
+    int pending;
+    long long last_flush_ns;
+    unsigned long long records;
+    unsigned long long writes;
+} Output;
+
+int output_format(const char *name);
+int output_open(Output *o, const char *path, int format, int ncores, int flush_every, long flush_ms);
+int output_open_labelled(Output *o, const char *path, int format, int flush_every, long flush_ms);
+int output_write(Output *o, const Sample *s);
+int output_write_labelled(Output *o, const char *label, const Sample *s);
+int output_flush(Output *o);
+void output_close(Output *o);
+
+#endif
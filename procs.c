@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "procs.h"
+#include "sampler.h"
+#include "sched.h"
+
+#define PROCS_START_CAP 1024
+#define PROCS_CLOCK_EVERY 16 // stat files read between two looks at the clock
+
+int procs_init(ProcTable *t, int top_n, int sort) {
+    memset(t, 0, sizeof(*t));
+    char path[PATH_MAX];
+    t->dir = opendir(proc_path("/proc", path));
+    if (t->dir == NULL) {
+        perror("opendir error, unable to read /proc");
+        return -1;
+    }
+    t->cap = PROCS_START_CAP;
+    t->slot = calloc(t->cap, sizeof(ProcEntry));
+    t->top = malloc((top_n > 0 ? top_n : 1) * sizeof(ProcEntry *));
+    if (t->slot == NULL || t->top == NULL) {
+        perror("malloc error, unable to allocate the process table");
+        procs_free(t);
+        return -1;
+    }
+    t->top_n = top_n;
+    t->sort = sort;
+    t->scan = 1; //0 marks the entries that no pass has seen
+    t->hz = sysconf(_SC_CLK_TCK);
+    t->page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    return 0;
+}
+
+void procs_free(ProcTable *t) {
+    if (t->dir != NULL) {
+        closedir(t->dir);
+    }
+    free(t->slot);
+    free(t->top);
+    t->dir = NULL;
+    t->slot = NULL;
+    t->top = NULL;
+}
+
+// The entry of pid, or the slot it should go in when it is not in the table
+static ProcEntry *procs_slot(ProcTable *t, int pid) {
+    size_t mask = t->cap - 1;
+    size_t i = ((unsigned)pid * 2654435761u) & mask;
+    ProcEntry *tomb = NULL;
+    for (;;) {
+        ProcEntry *e = &t->slot[i];
+        if (e->state == PROC_EMPTY) {
+            return tomb != NULL ? tomb : e;
+        }
+        if (e->state == PROC_DELETED) {
+            if (tomb == NULL) {
+                tomb = e;
+            }
+        }
+        else if (e->pid == pid) {
+            return e;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+// Rehashes the live entries into cap slots, which also drops the tombstones
+static int procs_resize(ProcTable *t, size_t cap) {
+    ProcEntry *old = t->slot;
+    size_t old_cap = t->cap;
+    t->slot = calloc(cap, sizeof(ProcEntry));
+    if (t->slot == NULL) {
+        t->slot = old;
+        return -1;
+    }
+    t->cap = cap;
+    t->deleted = 0;
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i].state == PROC_USED) {
+            *procs_slot(t, old[i].pid) = old[i];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+static const char *skip_fields(const char *p, int n) {
+    while (n-- > 0) {
+        while (*p == ' ') {
+            p++;
+        }
+        while (*p != ' ' && *p != '\0') {
+            p++;
+        }
+    }
+    return p;
+}
+
+// Reads /proc/<name>/stat into e, 0 when the process is still there.
+// rss comes from the same line (field 24 is statm's resident), so one file per pid is enough
+static int procs_read_stat(ProcTable *t, const char *name, ProcEntry *e) {
+    char path[32];
+    size_t len = strlen(name);
+    if (len > sizeof(path) - 6) {
+        return -1;
+    }
+    memcpy(path, name, len);
+    memcpy(path + len, "/stat", 6);
+    int fd = openat(dirfd(t->dir), path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return -1; //Exited since readdir saw it
+    }
+    char buf[1024];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) {
+        return -1;
+    }
+    buf[n] = '\0';
+
+    const char *open_paren = strchr(buf, '(');
+    const char *close_paren = strrchr(buf, ')'); //The name itself may contain ')'
+    if (open_paren == NULL || close_paren == NULL || close_paren < open_paren) {
+        return -1;
+    }
+    size_t comm_len = close_paren - open_paren - 1;
+    if (comm_len >= sizeof(e->comm)) {
+        comm_len = sizeof(e->comm) - 1;
+    }
+    memcpy(e->comm, open_paren + 1, comm_len);
+    e->comm[comm_len] = '\0';
+
+    const char *p = skip_fields(close_paren + 1, 11); //state up to cmajflt
+    e->ticks = scan_u64(&p);  //utime
+    e->ticks += scan_u64(&p); //stime
+    p = skip_fields(p, 6);    //cutime up to itrealvalue
+    e->start = scan_u64(&p);
+    p = skip_fields(p, 1);    //vsize
+    e->rss = scan_u64(&p) * t->page_kb;
+    return 0;
+}
+
+static int by_cpu(const void *a, const void *b);
+static int by_rss(const void *a, const void *b);
+
+// 1 when a ranks below b. Ties go to the other metric and then the pid, so idle processes keep their places
+static int proc_less(const ProcTable *t, const ProcEntry *a, const ProcEntry *b) {
+    return (t->sort == PROCS_BY_RSS ? by_rss(&a, &b) : by_cpu(&a, &b)) > 0;
+}
+
+// Keeps the top_n largest entries in a min-heap, so each pid costs one compare unless it makes the cut
+static void top_push(ProcTable *t, ProcEntry *e) {
+    ProcEntry **h = t->top;
+    int i;
+    if (t->ntop < t->top_n) {
+        i = t->ntop++;
+        while (i > 0 && proc_less(t, e, h[(i - 1) / 2])) { //Sift up
+            h[i] = h[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        h[i] = e;
+        return;
+    }
+    if (t->ntop == 0 || !proc_less(t, h[0], e)) {
+        return;
+    }
+    i = 0;
+    for (;;) { //Sift down from the root, which e replaces
+        int c = 2 * i + 1;
+        if (c >= t->ntop) {
+            break;
+        }
+        if (c + 1 < t->ntop && proc_less(t, h[c + 1], h[c])) {
+            c++;
+        }
+        if (!proc_less(t, h[c], e)) {
+            break;
+        }
+        h[i] = h[c];
+        i = c;
+    }
+    h[i] = e;
+}
+
+// qsort order, largest first
+static int by_cpu(const void *a, const void *b) {
+    const ProcEntry *x = *(ProcEntry *const *)a, *y = *(ProcEntry *const *)b;
+    if (x->cpu != y->cpu) {
+        return x->cpu < y->cpu ? 1 : -1;
+    }
+    if (x->rss != y->rss) {
+        return x->rss < y->rss ? 1 : -1;
+    }
+    return (x->pid > y->pid) - (x->pid < y->pid);
+}
+
+static int by_rss(const void *a, const void *b) {
+    const ProcEntry *x = *(ProcEntry *const *)a, *y = *(ProcEntry *const *)b;
+    if (x->rss != y->rss) {
+        return x->rss < y->rss ? 1 : -1;
+    }
+    if (x->cpu != y->cpu) {
+        return x->cpu < y->cpu ? 1 : -1;
+    }
+    return (x->pid > y->pid) - (x->pid < y->pid);
+}
+
+// Drops the pids that the pass that just ended did not find, and starts the next pass
+static void procs_end_pass(ProcTable *t) {
+    for (size_t i = 0; i < t->cap; i++) {
+        ProcEntry *e = &t->slot[i];
+        if (e->state == PROC_USED && e->seen != t->scan) { //Exited
+            e->state = PROC_DELETED;
+            t->used--;
+            t->deleted++;
+        }
+    }
+    rewinddir(t->dir);
+    t->scan++;
+    t->passes++;
+}
+
+// Reads the stat files of the next pids in /proc, updates the table and picks the top entries.
+// A scan ends with the pass, or once it spent budget_ns, and then the next one carries on from
+// the same directory position. A pass over every pid can therefore span several scans. Each
+// pid's CPU % covers the time since its own previous read
+void procs_scan(ProcTable *t, long long ts_ns) {
+    long long begin = t->budget_ns > 0 ? now_ns() : 0;
+    int read = 0;
+    for (;;) {
+        struct dirent *d = readdir(t->dir);
+        if (d == NULL) {
+            procs_end_pass(t); //A scan never starts a second pass, the pids it read are fresh enough
+            break;
+        }
+        if (d->d_name[0] < '1' || d->d_name[0] > '9') {
+            continue; //Not a pid
+        }
+        int pid = atoi(d->d_name);
+        if ((t->used + t->deleted + 1) * 4 > t->cap * 3) {
+            size_t cap = t->cap;
+            while ((t->used + 1) * 2 > cap) {
+                cap *= 2;
+            }
+            if (procs_resize(t, cap) == -1) {
+                perror("calloc error, unable to grow the process table");
+                return;
+            }
+        }
+        ProcEntry *e = procs_slot(t, pid);
+        ProcEntry now;
+        if (procs_read_stat(t, d->d_name, &now) == -1) {
+            continue;
+        }
+        if (e->state == PROC_USED && e->start == now.start) {
+            double dt = (ts_ns - e->read_ns) / 1e9;
+            now.cpu = dt <= 0 ? e->cpu : now.ticks >= e->ticks ? (now.ticks - e->ticks) * 100.0 / t->hz / dt : 0;
+        }
+        else {
+            now.cpu = 0; //New since its last read, no delta yet
+            if (e->state == PROC_DELETED) {
+                t->deleted--;
+            }
+            if (e->state != PROC_USED) {
+                t->used++;
+            }
+        }
+        now.pid = pid;
+        now.state = PROC_USED;
+        now.seen = t->scan;
+        now.read_ns = ts_ns;
+        *e = now;
+        if (t->budget_ns > 0 && ++read % PROCS_CLOCK_EVERY == 0 && now_ns() - begin >= t->budget_ns) {
+            break;
+        }
+    }
+    t->nprocs = t->used;
+
+    t->ntop = 0;
+    for (size_t i = 0; i < t->cap; i++) {
+        if (t->slot[i].state == PROC_USED) {
+            top_push(t, &t->slot[i]);
+        }
+    }
+    qsort(t->top, t->ntop, sizeof(ProcEntry *), t->sort == PROCS_BY_RSS ? by_rss : by_cpu);
+}
+
+// Collector wrapper for the scheduler
+void procs_collect(void *ctx, long long ts_ns) {
+    procs_scan(ctx, ts_ns);
+}
@@ -0,0 +1,52 @@
+#ifndef PROCS_H
+#define PROCS_H
+
+#include <dirent.h>
+
+#define PROCS_BY_CPU 0
+#define PROCS_BY_RSS 1
+
+#define PROCS_BUDGET_PCT 2 // share of the scan period that one scan may spend reading stat files
+
+#define PROC_EMPTY 0
+#define PROC_USED 1
+#define PROC_DELETED 2 // tombstone, keeps the probe chains behind it intact
+
+// What the last scans found about one pid
+typedef struct {
+    int pid;
+    int state;                // PROC_EMPTY, PROC_USED or PROC_DELETED
+    unsigned long long start; // starttime, tells a reused pid from the process that had it before
+    unsigned long long ticks; // utime + stime at the last scan
+    unsigned long long rss;   // kB
+    unsigned long long seen;  // pass that last found it
+    long long read_ns;        // when its stat file was read last
+    float cpu;                // % of one cpu between the last two scans
+    char comm[16];
+} ProcEntry;
+
+// Every process under /proc, kept across scans so only the deltas are computed
+typedef struct {
+    DIR *dir;              // /proc, rewound every scan, the stat files are opened relative to it
+    ProcEntry *slot;       // open addressing on pid, cap is a power of two
+    size_t cap;
+    size_t used;           // live entries
+    size_t deleted;        // tombstones
+    unsigned long long scan;   // pass over /proc in progress
+    unsigned long long passes; // passes completed
+    long long budget_ns;   // time one scan may spend reading stat files, 0 for a whole pass every scan
+    long hz;
+    long page_kb;
+    int sort;              // PROCS_BY_CPU or PROCS_BY_RSS
+    int top_n;
+    ProcEntry **top;       // the top_n largest by sort after a scan, largest first
+    int ntop;
+    unsigned long nprocs;  // processes in the table after the last scan
+} ProcTable;
+
+int procs_init(ProcTable *t, int top_n, int sort);
+void procs_scan(ProcTable *t, long long ts_ns);
+void procs_collect(void *ctx, long long ts_ns);
+void procs_free(ProcTable *t);
+
+#endif
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/epoll.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+#include "psi.h"
+
+static const char *psi_names[PSI_RESOURCES] = { "cpu", "memory", "io" };
+
+// Registers "some stall_us window_us" on fd. Without CAP_SYS_RESOURCE the kernel only takes
+// windows that are a multiple of 2s, then the window is stretched to one and the stall with it
+static int psi_trigger_write(PsiTable *t, int fd) {
+    long stall_us = t->stall_us, window_us = t->window_us;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        char trigger[64];
+        int len = snprintf(trigger, sizeof(trigger), "some %ld %ld", stall_us, window_us);
+        if (write(fd, trigger, len + 1) != -1) { //The kernel wants the '\0' too
+            t->stall_us = stall_us;
+            t->window_us = window_us;
+            return 0;
+        }
+        long unprivileged = (window_us + PSI_UNPRIV_WINDOW - 1) / PSI_UNPRIV_WINDOW * PSI_UNPRIV_WINDOW;
+        if ((errno != EINVAL && errno != EPERM) || unprivileged == window_us) {
+            break;
+        }
+        stall_us = stall_us * (unprivileged / window_us);
+        window_us = unprivileged;
+    }
+    return -1;
+}
+
+// Opens every pressure file that exists and registers a trigger on it. Without a trigger the
+// values are still polled
+int psi_init(PsiTable *t, long stall_us, long window_us) {
+    memset(t, 0, sizeof(*t));
+    t->stall_us = stall_us;
+    t->window_us = window_us;
+    int opened = 0;
+    for (int i = 0; i < PSI_RESOURCES; i++) {
+        PsiResource *r = &t->res[i];
+        r->name = psi_names[i];
+        r->file = (ProcFile)PROC_FILE_INIT;
+        r->trigger_fd = -1;
+        r->table = t;
+        char name[32], path[PATH_MAX];
+        snprintf(name, sizeof(name), "/proc/pressure/%s", r->name);
+        proc_path(name, path);
+        if (proc_open(&r->file, path) == -1) {
+            continue; //A kernel without PSI, or booted with psi=0
+        }
+        opened++;
+
+        struct statfs fs;
+        if (fstatfs(r->file.fd, &fs) == -1 || fs.f_type != PROC_SUPER_MAGIC) {
+            continue; //A copy under --proc-root, writing a trigger would overwrite it
+        }
+        r->trigger_fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (r->trigger_fd != -1 && psi_trigger_write(t, r->trigger_fd) == -1) {
+            close(r->trigger_fd);
+            r->trigger_fd = -1;
+        }
+        t->triggers += r->trigger_fd != -1;
+    }
+    if (opened == 0) {
+        fprintf(stderr, "no /proc/pressure files, the kernel needs CONFIG_PSI and psi=1\n");
+        return -1;
+    }
+    return psi_read(t, 0);
+}
+
+void psi_free(PsiTable *t) {
+    for (int i = 0; i < PSI_RESOURCES; i++) {
+        PsiResource *r = &t->res[i];
+        proc_close(&r->file);
+        if (r->trigger_fd != -1) {
+            close(r->trigger_fd);
+            r->trigger_fd = -1;
+        }
+    }
+    t->triggers = 0;
+}
+
+// "avg10=0.43 avg60=1.17 avg300=2.30 total=40142509", p points just after "some" or "full"
+static void parse_line(const char *p, PsiLine *line) {
+    float *avg[] = { &line->avg10, &line->avg60, &line->avg300 };
+    for (int i = 0; i < 3; i++) {
+        p = strchr(p, '=');
+        if (p == NULL) {
+            return;
+        }
+        p++;
+        unsigned long long whole = scan_u64(&p);
+        unsigned long long hundredths = 0;
+        if (*p == '.') {
+            p++;
+            hundredths = scan_u64(&p); //Always two digits
+        }
+        *avg[i] = whole + hundredths / 100.0f;
+    }
+    p = strchr(p, '=');
+    if (p != NULL) {
+        p++;
+        line->total = scan_u64(&p);
+    }
+}
+
+// Re-reads one resource. dt is the time since its totals were last taken, below 0 only the
+// averages are updated so the next periodic read still measures its whole interval
+static int read_resource(PsiResource *r, double dt) {
+    if (proc_read(&r->file) == -1) {
+        perror("unable to read /proc/pressure");
+        return -1;
+    }
+    PsiLine some = r->some, full = r->full;
+    const char *p = r->file.buf;
+    while (p != NULL && *p != '\0') {
+        if (strncmp(p, "some", 4) == 0) {
+            parse_line(p + 4, &some);
+        }
+        else if (strncmp(p, "full", 4) == 0) {
+            parse_line(p + 4, &full);
+        }
+        p = strchr(p, '\n');
+        p = p != NULL ? p + 1 : NULL;
+    }
+    if (dt < 0) {
+        some.total = r->some.total;
+        full.total = r->full.total;
+    }
+    else if (dt > 0) {
+        r->some_ms = some.total >= r->some.total ? (some.total - r->some.total) / 1000.0 / dt : 0;
+        r->full_ms = full.total >= r->full.total ? (full.total - r->full.total) / 1000.0 / dt : 0;
+    }
+    r->some = some;
+    r->full = full;
+    return 0;
+}
+
+// Re-reads every resource, ts_ns 0 only sets the baseline
+int psi_read(PsiTable *t, long long ts_ns) {
+    double dt = t->last_ns > 0 && ts_ns > t->last_ns ? (ts_ns - t->last_ns) / 1e9 : 0;
+    t->last_ns = ts_ns;
+    for (int i = 0; i < PSI_RESOURCES; i++) {
+        if (t->res[i].file.fd != -1 && read_resource(&t->res[i], dt) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// A trigger fired: more than the threshold of stall within the window. The averages are
+// refreshed right away, the ms/s rates keep waiting for the next periodic read
+static void psi_trigger(void *ctx, uint32_t events) {
+    PsiResource *r = ctx;
+    if (events & EPOLLERR) { //The pressure file went away, stop watching it or epoll keeps reporting it
+        sched_unwatch(r->table->sched, &r->watch);
+        close(r->trigger_fd);
+        r->trigger_fd = -1;
+        r->table->triggers--;
+        return;
+    }
+    r->events++;
+    r->event_ns = now_ns();
+    read_resource(r, -1);
+    if (r->table->on_event != NULL) {
+        r->table->on_event(r->table->ctx, r);
+    }
+}
+
+// Watches every registered trigger alongside the scheduler's timer
+int psi_watch(PsiTable *t, Scheduler *sched) {
+    t->sched = sched;
+    for (int i = 0; i < PSI_RESOURCES; i++) {
+        PsiResource *r = &t->res[i];
+        if (r->trigger_fd == -1) {
+            continue;
+        }
+        r->watch.fd = r->trigger_fd;
+        r->watch.fn = psi_trigger;
+        r->watch.ctx = r;
+        if (sched_watch(sched, &r->watch, EPOLLPRI) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Collector wrapper for the scheduler
+void psi_collect(void *ctx, long long ts_ns) {
+    psi_read(ctx, ts_ns);
+}
@@ -0,0 +1,55 @@
+#ifndef PSI_H
+#define PSI_H
+
+#include "sampler.h"
+#include "sched.h"
+
+#define PSI_CPU 0
+#define PSI_MEMORY 1
+#define PSI_IO 2
+#define PSI_RESOURCES 3
+#define PSI_UNPRIV_WINDOW 2000000 // µs, unprivileged triggers need a window that is a multiple of this
+
+// One "some" or "full" line of a /proc/pressure file, the averages are % of wall time
+typedef struct {
+    float avg10, avg60, avg300;
+    unsigned long long total; // µs stalled since boot
+} PsiLine;
+
+struct PsiTable;
+
+// One of /proc/pressure/{cpu,memory,io}
+typedef struct {
+    const char *name;
+    ProcFile file;
+    PsiLine some, full;
+    float some_ms, full_ms;  // ms stalled per second since the previous read
+    int trigger_fd;          // -1 when no trigger could be registered
+    Watch watch;
+    unsigned long events;    // times the trigger fired
+    long long event_ns;      // CLOCK_MONOTONIC of the last one
+    struct PsiTable *table;
+} PsiResource;
+
+typedef void (*psi_event_fn)(void *ctx, PsiResource *r);
+
+// Pressure of every resource. The files are re-read every period, and the kernel triggers
+// (more than stall_us of "some" stall within window_us) are watched by the scheduler so an
+// event is seen as soon as the kernel raises it
+typedef struct PsiTable {
+    PsiResource res[PSI_RESOURCES];
+    int triggers;            // how many resources have one
+    long stall_us, window_us; // the threshold the kernel accepted
+    long long last_ns;
+    Scheduler *sched;        // watching the triggers, set by psi_watch
+    psi_event_fn on_event;   // called as soon as a trigger fires, after the resource was re-read
+    void *ctx;
+} PsiTable;
+
+int psi_init(PsiTable *t, long stall_us, long window_us);
+int psi_watch(PsiTable *t, Scheduler *sched);
+int psi_read(PsiTable *t, long long ts_ns);
+void psi_collect(void *ctx, long long ts_ns);
+void psi_free(PsiTable *t);
+
+#endif
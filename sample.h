@@ -0,0 +1,28 @@
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <stddef.h>
+
+#define MAX_CORES 512
+
+// One tick of every metric. This is what gets plotted, recorded and replayed.
+// New scalar metrics go before ncores so they stay part of the fixed-size head
+typedef struct {
+    long long ts_ns; //CLOCK_REALTIME when the sample was taken
+    float cpu; //aggregate utilization in %
+    float mem_used; //GB, MemTotal - MemAvailable
+    float mem_total; //GB
+    float mem_available;
+    float mem_cached;
+    float mem_buffers;
+    float mem_dirty;
+    float mem_shmem;
+    float swap_total;
+    float swap_used; //GB
+    int ncores;
+    float core[MAX_CORES]; //per-core utilization in %, only the first ncores are used
+} Sample;
+
+#define SAMPLE_HEAD_SIZE offsetof(Sample, ncores)
+
+#endif
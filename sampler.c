@@ -0,0 +1,426 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include "sampler.h"
+
+#define PROC_BUF_START 4096
+
+static ProcFile stat_file = PROC_FILE_INIT;
+static ProcFile meminfo_file = PROC_FILE_INIT;
+static ProcFile vmstat_file = PROC_FILE_INIT;
+static char proc_root[PATH_MAX / 2] = ""; //Prefix for every /proc and /sys path, empty reads this machine
+
+// Reads /proc and /sys under root instead, e.g. a directory of fixture files. NULL or "" goes back to /
+void sampler_set_root(const char *root) {
+    snprintf(proc_root, sizeof(proc_root), "%s", root != NULL ? root : "");
+    proc_close(&stat_file); //Reopened under the new root on the next read
+    proc_close(&meminfo_file);
+    proc_close(&vmstat_file);
+}
+
+// Where path is under the configured root, buf has to hold PATH_MAX bytes
+const char *proc_path(const char *path, char *buf) {
+    snprintf(buf, PATH_MAX, "%s%s", proc_root, path);
+    return buf;
+}
+
+// Opens the file once, the buffer is allocated here and only grows if the file outgrows it
+int proc_open(ProcFile *pf, const char *path) {
+    pf->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (pf->fd == -1) {
+        return -1;
+    }
+    pf->cap = PROC_BUF_START;
+    pf->len = 0;
+    pf->buf = malloc(pf->cap + 1); // +1 for the terminating '\0'
+    if (pf->buf == NULL) {
+        close(pf->fd);
+        pf->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+// Re-reads the whole file from offset 0. A short read means we have all of it,
+// so in the steady state this is a single pread and no allocation
+ssize_t proc_read(ProcFile *pf) {
+    size_t len = 0;
+    for (;;) {
+        ssize_t n = pread(pf->fd, pf->buf + len, pf->cap - len, len);
+        if (n < 0) {
+            return -1;
+        }
+        len += n;
+        if (len < pf->cap || n == 0) {
+            break;
+        }
+        char *bigger = realloc(pf->buf, pf->cap * 2 + 1); //The file did not fit, grow the buffer and keep reading
+        if (bigger == NULL) {
+            return -1;
+        }
+        pf->buf = bigger;
+        pf->cap *= 2;
+    }
+    pf->buf[len] = '\0';
+    pf->len = len;
+    return len;
+}
+
+void proc_close(ProcFile *pf) {
+    if (pf->fd != -1) {
+        close(pf->fd);
+    }
+    free(pf->buf);
+    pf->fd = -1;
+    pf->buf = NULL;
+    pf->cap = pf->len = 0;
+}
+
+static int proc_ensure(ProcFile *pf, const char *path) {
+    if (pf->fd != -1) {
+        return 0;
+    }
+    char full[PATH_MAX];
+    return proc_open(pf, proc_path(path, full));
+}
+
+// Parses the times of one "cpu" or "cpuN" line, p points just after the label
+static void parse_cpu_times(const char *p, CPUStats *stats) {
+    unsigned long long user = scan_u64(&p);
+    unsigned long long nice = scan_u64(&p);
+    unsigned long long system = scan_u64(&p);
+    unsigned long long idle = scan_u64(&p);
+    unsigned long long iowait = scan_u64(&p);
+    unsigned long long irq = scan_u64(&p);
+    unsigned long long softirq = scan_u64(&p);
+    unsigned long long steal = scan_u64(&p);
+    unsigned long long guest = scan_u64(&p);
+
+    unsigned long long idle_time = idle + iowait;
+    unsigned long long non_idle_time = user + nice + system + irq + softirq + steal + guest;
+    stats->total = idle_time + non_idle_time;
+    stats->idle = idle_time;
+}
+
+// Number of possible cpus, cpuN lines are indexed by N so per-core arrays are sized for all of them.
+// The highest id in sysfs' "possible" list (e.g. "0-511"), sysconf when that cannot be read
+int cpu_count() {
+    ProcFile pf = PROC_FILE_INIT;
+    int n = 0;
+    if (proc_ensure(&pf, "/sys/devices/system/cpu/possible") == 0 && proc_read(&pf) > 0) {
+        const char *p = pf.buf;
+        while (*p >= '0' && *p <= '9') {
+            unsigned long long id = scan_u64(&p);
+            if ((int)id + 1 > n) {
+                n = id + 1;
+            }
+            if (*p == '-' || *p == ',') {
+                p++;
+            }
+        }
+    }
+    proc_close(&pf);
+    if (n < 1) {
+        n = sysconf(_SC_NPROCESSORS_CONF);
+    }
+    return n < 1 ? 1 : n;
+}
+
+// Sets mask[id] for every id of a sysfs cpu list such as "0-3,8,10-11" that is below n,
+// returns how many were set
+int cpulist_mark(const char *p, char *mask, int n) {
+    int marked = 0;
+    while (*p >= '0' && *p <= '9') {
+        unsigned long long first = scan_u64(&p), last = first;
+        if (*p == '-') {
+            p++;
+            last = scan_u64(&p);
+        }
+        for (unsigned long long id = first; id <= last && id < (unsigned long long)n; id++) {
+            marked += !mask[id];
+            mask[id] = 1;
+        }
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return marked;
+}
+
+// Number of online cpus from sysfs, -1 when the list cannot be read
+int cpu_online_count() {
+    ProcFile pf = PROC_FILE_INIT;
+    int n = -1;
+    if (proc_ensure(&pf, "/sys/devices/system/cpu/online") == 0 && proc_read(&pf) > 0) {
+        int possible = cpu_count();
+        char *mask = calloc(possible, 1);
+        if (mask != NULL) {
+            n = cpulist_mark(pf.buf, mask, possible);
+            free(mask);
+        }
+    }
+    proc_close(&pf);
+    return n > 0 ? n : -1;
+}
+
+// Counts the processor entries of /proc/cpuinfo, -1 when it cannot be read
+int cpuinfo_count() {
+    char path[PATH_MAX];
+    FILE *file = fopen(proc_path("/proc/cpuinfo", path), "r");
+    if (file == NULL) {
+        return -1;
+    }
+    char buffer[1024];
+    int cores = 0;
+    while (fgets(buffer, sizeof(buffer), file)) {
+        if (strncmp(buffer, "processor", 9) == 0 && (buffer[9] == '\t' || buffer[9] == ' ' || buffer[9] == ':')) {
+            cores++; //Incrementing the number of cores
+        }
+    }
+    fclose(file);
+    return cores;
+}
+
+int stat_init(StatSample *s) {
+    memset(s, 0, sizeof(*s));
+    int n = cpu_count();
+    s->core = calloc(n, sizeof(CPUStats));
+    if (s->core == NULL) {
+        perror("calloc error, unable to allocate per-core counters");
+        return -1;
+    }
+    s->ncores = n;
+    return 0;
+}
+
+void stat_free(StatSample *s) {
+    free(s->core);
+    s->core = NULL;
+    s->ncores = 0;
+}
+
+static int starts_with(const char *p, const char *end, const char *word, size_t len) {
+    return (size_t)(end - p) >= len && memcmp(p, word, len) == 0;
+}
+
+// Reads /proc/stat once and fills every line we know about
+int stat_read(StatSample *s) {
+    if (proc_ensure(&stat_file, "/proc/stat") == -1 || proc_read(&stat_file) == -1) {
+        perror("unable to read /proc/stat");
+        return -1;
+    }
+    const char *p = stat_file.buf;
+    const char *end = p + stat_file.len;
+
+    while (p < end) {
+        const char *nl = memchr(p, '\n', end - p);
+        if (nl == NULL) {
+            nl = end;
+        }
+        const char *q;
+        switch (*p) {
+        case 'c':
+            if (starts_with(p, nl, "cpu ", 4)) {
+                parse_cpu_times(p + 4, &s->cpu);
+            }
+            else if (starts_with(p, nl, "cpu", 3)) {
+                q = p + 3;
+                unsigned long long n = scan_u64(&q);
+                if (s->core != NULL && n < (unsigned long long)s->ncores) {
+                    parse_cpu_times(q, &s->core[n]);
+                }
+            }
+            else if (starts_with(p, nl, "ctxt ", 5)) {
+                q = p + 5;
+                s->ctxt = scan_u64(&q);
+            }
+            break;
+        case 'i':
+            if (starts_with(p, nl, "intr ", 5)) {
+                q = p + 5;
+                s->intr = scan_u64(&q); //Only the total, the per-irq counts are skipped by memchr
+            }
+            break;
+        case 'b':
+            if (starts_with(p, nl, "btime ", 6)) {
+                q = p + 6;
+                s->btime = scan_u64(&q);
+            }
+            break;
+        case 'p':
+            if (starts_with(p, nl, "processes ", 10)) {
+                q = p + 10;
+                s->processes = scan_u64(&q);
+            }
+            else if (starts_with(p, nl, "procs_running ", 14)) {
+                q = p + 14;
+                s->procs_running = scan_u64(&q);
+            }
+            else if (starts_with(p, nl, "procs_blocked ", 14)) {
+                q = p + 14;
+                s->procs_blocked = scan_u64(&q);
+            }
+            break;
+        case 's':
+            if (starts_with(p, nl, "softirq ", 8)) {
+                q = p + 8;
+                s->softirq = scan_u64(&q);
+            }
+            break;
+        }
+        p = nl + 1;
+    }
+    return 0;
+}
+
+static const struct {
+    const char *key;
+    size_t len;
+    size_t off;
+} meminfo_keys[] = {
+    { "MemTotal:", 9, offsetof(MemInfo, total) },
+    { "MemFree:", 8, offsetof(MemInfo, free) },
+    { "MemAvailable:", 13, offsetof(MemInfo, available) },
+    { "Buffers:", 8, offsetof(MemInfo, buffers) },
+    { "Cached:", 7, offsetof(MemInfo, cached) },
+    { "SwapTotal:", 10, offsetof(MemInfo, swap_total) },
+    { "SwapFree:", 9, offsetof(MemInfo, swap_free) },
+    { "Dirty:", 6, offsetof(MemInfo, dirty) },
+    { "Shmem:", 6, offsetof(MemInfo, shmem) },
+};
+
+// Reads /proc/meminfo once and picks out the fields in meminfo_keys
+int meminfo_read(MemInfo *m) {
+    if (proc_ensure(&meminfo_file, "/proc/meminfo") == -1 || proc_read(&meminfo_file) == -1) {
+        perror("unable to read /proc/meminfo");
+        return -1;
+    }
+    memset(m, 0, sizeof(*m));
+    const char *p = meminfo_file.buf;
+    const char *end = p + meminfo_file.len;
+    size_t nkeys = sizeof(meminfo_keys) / sizeof(meminfo_keys[0]);
+    size_t found = 0;
+
+    while (p < end && found < nkeys) {
+        const char *nl = memchr(p, '\n', end - p);
+        if (nl == NULL) {
+            nl = end;
+        }
+        for (size_t i = 0; i < nkeys; i++) {
+            if (starts_with(p, nl, meminfo_keys[i].key, meminfo_keys[i].len)) {
+                const char *q = p + meminfo_keys[i].len;
+                *(unsigned long long *)((char *)m + meminfo_keys[i].off) = scan_u64(&q);
+                found++;
+                break;
+            }
+        }
+        p = nl + 1;
+    }
+    if (m->available == 0) {
+        m->available = m->free + m->buffers + m->cached; //Kernels before 3.14 have no MemAvailable
+    }
+    return 0;
+}
+
+static const struct {
+    const char *key;
+    size_t len;
+    size_t off;
+} vmstat_keys[] = {
+    { "pgfault ", 8, offsetof(VmStat, pgfault) },
+    { "pgmajfault ", 11, offsetof(VmStat, pgmajfault) },
+    { "pswpin ", 7, offsetof(VmStat, pswpin) },
+    { "pswpout ", 8, offsetof(VmStat, pswpout) },
+};
+
+// Reads /proc/vmstat once. It has well over a hundred lines and ours all start with 'p',
+// so every other line costs a single compare
+int vmstat_read(VmStat *v) {
+    if (proc_ensure(&vmstat_file, "/proc/vmstat") == -1 || proc_read(&vmstat_file) == -1) {
+        perror("unable to read /proc/vmstat");
+        return -1;
+    }
+    memset(v, 0, sizeof(*v));
+    const char *p = vmstat_file.buf;
+    const char *end = p + vmstat_file.len;
+    size_t nkeys = sizeof(vmstat_keys) / sizeof(vmstat_keys[0]);
+    size_t found = 0;
+
+    while (p < end && found < nkeys) {
+        const char *nl = memchr(p, '\n', end - p);
+        if (nl == NULL) {
+            nl = end;
+        }
+        if (*p == 'p') {
+            for (size_t i = 0; i < nkeys; i++) {
+                if (starts_with(p, nl, vmstat_keys[i].key, vmstat_keys[i].len)) {
+                    const char *q = p + vmstat_keys[i].len;
+                    *(unsigned long long *)((char *)v + vmstat_keys[i].off) = scan_u64(&q);
+                    found++;
+                    break;
+                }
+            }
+        }
+        p = nl + 1;
+    }
+    return 0;
+}
+
+// function to get the cpu utilization for the current sample
+CPUStats get_cpu_utilization() {
+    static StatSample s; //core is left NULL so the per-core lines are skipped
+    if (stat_read(&s) == -1) {
+        exit(1);
+    }
+    return s.cpu;
+}
+
+float get_cpu_percentage(CPUStats prev, CPUStats curr) {
+    unsigned long long int total_diff = curr.total - prev.total; //Calculating the difference between the total time
+    unsigned long long int idle_diff = curr.idle - prev.idle;   //Calculating the difference between the idle time
+    if(total_diff == 0){
+        return 0; //No ticks passed, e.g. an offline core
+    }
+    float utilization = 100.0 * (total_diff - idle_diff) / total_diff; //Calculating the CPU utilization
+    return utilization;
+}
+
+// function to get the total ram in the system in GB, fractions included
+float get_ram() {
+    MemInfo m;
+    if (meminfo_read(&m) == 0) {
+        return m.total / KB_PER_GB;
+    } else {
+        perror("meminfo error, unable to get memory utilization");
+        return 0;
+    }
+}
+
+// function to get the y value for the memory utilization for the current sample
+int get_ram_y() {
+    MemInfo m;
+    if (meminfo_read(&m) == 0 && m.total > 0) {
+        float used = (float)(m.total - m.available); //Page cache can be reclaimed, so it is not counted as used
+        int y = (int)(used / m.total * MEM_SCALE + 0.5); //Calculating the y value for memory utilization
+
+        return y;
+    } else {
+        perror("meminfo error, unable to get memory utilization");
+        exit(1);
+    }
+}
+
+// function to get the used memory in GB for the current sample, everything but MemAvailable
+float get_ram_used() {
+    MemInfo m;
+    if (meminfo_read(&m) == 0) {
+        return (m.total - m.available) / KB_PER_GB;
+    } else {
+        perror("meminfo error, unable to get memory utilization");
+        exit(1);
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+//macro for memory y axis
+#define MEM_SCALE 12
+
+// A /proc or /sys file that is opened once and re-read with pread into a reusable buffer
+typedef struct {
+    int fd;
+    char *buf;
+    size_t cap;
+    size_t len;
+} ProcFile;
+
+#define PROC_FILE_INIT { -1, NULL, 0, 0 }
+
+typedef struct {
+    unsigned long total;
+    unsigned long idle;
+} CPUStats;
+
+// Everything parsed out of one read of /proc/stat
+typedef struct {
+    CPUStats cpu;    // aggregate "cpu" line
+    CPUStats *core;  // one entry per "cpuN" line, indexed by N. NULL skips the per-core lines
+    int ncores;      // number of entries in core, fixed at stat_init
+    unsigned long long intr, ctxt, btime, processes, procs_running, procs_blocked, softirq;
+} StatSample;
+
+// Values from /proc/meminfo, all in kB
+typedef struct {
+    unsigned long long total;
+    unsigned long long free;
+    unsigned long long available; // free plus what can be reclaimed without swapping
+    unsigned long long buffers;
+    unsigned long long cached;
+    unsigned long long dirty;
+    unsigned long long shmem;
+    unsigned long long swap_total;
+    unsigned long long swap_free;
+} MemInfo;
+
+// Paging counters from /proc/vmstat, in pages or events since boot
+typedef struct {
+    unsigned long long pgfault;
+    unsigned long long pgmajfault; // faults that had to wait for a read from disk
+    unsigned long long pswpin;
+    unsigned long long pswpout;
+} VmStat;
+
+#define KB_PER_GB (1024.0f * 1024.0f)
+
+void sampler_set_root(const char *root);
+const char *proc_path(const char *path, char *buf);
+int proc_open(ProcFile *pf, const char *path);
+ssize_t proc_read(ProcFile *pf);
+void proc_close(ProcFile *pf);
+
+int cpu_count();
+int cpulist_mark(const char *p, char *mask, int n);
+int cpu_online_count();
+int cpuinfo_count();
+int stat_init(StatSample *s);
+void stat_free(StatSample *s);
+int stat_read(StatSample *s);
+int meminfo_read(MemInfo *m);
+int vmstat_read(VmStat *v);
+
+CPUStats get_cpu_utilization();
+float get_cpu_percentage(CPUStats prev, CPUStats curr);
+float get_ram();
+int get_ram_y();
+float get_ram_used();
+
+// Skip blanks and read an unsigned decimal integer, leaving *p after the last digit
+static inline unsigned long long scan_u64(const char **p) {
+    const char *s = *p;
+    unsigned long long v = 0;
+    while (*s == ' ' || *s == '\t') {
+        s++;
+    }
+    while (*s >= '0' && *s <= '9') {
+        v = v * 10 + (unsigned long long)(*s - '0');
+        s++;
+    }
+    *p = s;
+    return v;
+}
+
+#endif
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/prctl.h>
+#include "sched.h"
+#include "selfstats.h"
+
+#define NSEC 1000000000LL
+
+long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NSEC + ts.tv_nsec;
+}
+
+// CLOCK_REALTIME, for timestamps that are stored or exported
+long long wall_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * NSEC + ts.tv_nsec;
+}
+
+int sched_init(Scheduler *s) {
+    memset(s, 0, sizeof(*s));
+    s->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (s->tfd == -1) {
+        perror("timerfd_create error");
+        return -1;
+    }
+    s->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (s->epfd == -1) {
+        perror("epoll_create1 error");
+        close(s->tfd);
+        return -1;
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL }; //NULL marks the timer
+    if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, s->tfd, &ev) == -1) {
+        perror("epoll_ctl error");
+        sched_close(s);
+        return -1;
+    }
+    prctl(PR_SET_TIMERSLACK, 1UL); //The default 50us of slack is a lot at millisecond periods
+    s->start_ns = now_ns();
+    return 0;
+}
+
+// Deadlines are counted from the scheduler's start so collectors with the same period stay in phase
+Collector *sched_add(Scheduler *s, const char *name, long period_us, collector_fn fn, void *ctx) {
+    if (s->ncol == SCHED_MAX_COLLECTORS || period_us <= 0) {
+        return NULL;
+    }
+    Collector *c = &s->col[s->ncol++];
+    memset(c, 0, sizeof(*c));
+    c->name = name;
+    c->fn = fn;
+    c->ctx = ctx;
+    c->period_ns = period_us * 1000LL;
+    c->next_ns = s->start_ns + c->period_ns;
+    long long now = now_ns();
+    if (c->next_ns <= now) { //Added after the first deadline, join at the next one
+        c->next_ns += ((now - c->next_ns) / c->period_ns + 1) * c->period_ns;
+    }
+    return c;
+}
+
+// The next deadline moves to one new period after the last run. Collectors given the same
+// period right after running together stay in phase
+void sched_set_period(Scheduler *s, Collector *c, long long period_ns) {
+    if (period_ns <= 0 || period_ns == c->period_ns) {
+        return;
+    }
+    c->period_ns = period_ns;
+    long long base = c->last_ns > 0 ? c->last_ns : s->start_ns;
+    c->next_ns = base + period_ns; //Already due when it is in the past, sched_arm picks it up
+}
+
+int sched_watch(Scheduler *s, Watch *w, uint32_t events) {
+    struct epoll_event ev = { .events = events, .data.ptr = w };
+    if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, w->fd, &ev) == -1) {
+        perror("epoll_ctl error");
+        return -1;
+    }
+    return 0;
+}
+
+int sched_unwatch(Scheduler *s, Watch *w) {
+    return epoll_ctl(s->epfd, EPOLL_CTL_DEL, w->fd, NULL);
+}
+
+static void sched_arm(Scheduler *s) {
+    long long next = 0;
+    for (int i = 0; i < s->ncol; i++) {
+        if (next == 0 || s->col[i].next_ns < next) {
+            next = s->col[i].next_ns;
+        }
+    }
+    if (next == s->armed_ns) {
+        return;
+    }
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its)); //A zero value disarms the timer when there are no collectors
+    its.it_value.tv_sec = next / NSEC;
+    its.it_value.tv_nsec = next % NSEC;
+    timerfd_settime(s->tfd, TFD_TIMER_ABSTIME, &its, NULL);
+    s->armed_ns = next;
+}
+
+// Waits for the next deadline or watched fd, then runs everything that is due.
+// Returns how many collectors ran, 0 when woken by an fd or a signal only
+int sched_run_once(Scheduler *s) {
+    sched_arm(s);
+
+    struct epoll_event ev[16];
+    int n = epoll_wait(s->epfd, ev, 16, -1);
+    if (n == -1) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        perror("epoll_wait error");
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        if (ev[i].data.ptr == NULL) {
+            unsigned long long expirations;
+            if (read(s->tfd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) {
+                perror("timerfd read error");
+                return -1;
+            }
+            s->armed_ns = 0; //One-shot, it has to be armed again
+        }
+        else {
+            Watch *w = ev[i].data.ptr;
+            w->fn(w->ctx, ev[i].events);
+        }
+    }
+
+    int ran = 0;
+    long long now = now_ns(); //Every collector due in this wakeup shares one timestamp
+    for (int i = 0; i < s->ncol; i++) {
+        Collector *c = &s->col[i];
+        if (c->next_ns > now) {
+            continue;
+        }
+        c->late_ns = now - c->next_ns;
+        c->last_ns = now;
+        long long begin = now_ns();
+        c->fn(c->ctx, now);
+        c->runs++;
+        ran++;
+
+        c->next_ns += c->period_ns;
+        long long after = now_ns();
+        if (c->latency != NULL) {
+            hist_add(c->latency, after - begin);
+        }
+        if (c->jitter != NULL) {
+            hist_add(c->jitter, c->late_ns);
+        }
+        if (c->next_ns <= after) { //Skip the deadlines we already missed instead of bursting to catch up
+            long long behind = (after - c->next_ns) / c->period_ns + 1;
+            c->missed += behind;
+            c->next_ns += behind * c->period_ns;
+        }
+    }
+    return ran;
+}
+
+void sched_close(Scheduler *s) {
+    if (s->epfd != -1) {
+        close(s->epfd);
+    }
+    if (s->tfd != -1) {
+        close(s->tfd);
+    }
+    s->epfd = s->tfd = -1;
+}
@@ -0,0 +1,56 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+
+#define SCHED_MAX_COLLECTORS 16
+
+struct Histogram;
+
+// Called when a collector is due, ts_ns is the CLOCK_MONOTONIC time it actually ran at
+typedef void (*collector_fn)(void *ctx, long long ts_ns);
+// Called when a watched file descriptor is ready
+typedef void (*watch_fn)(void *ctx, uint32_t events);
+
+typedef struct {
+    const char *name;
+    collector_fn fn;
+    void *ctx;
+    long long period_ns;
+    long long next_ns;   // absolute deadline, start + k * period until the period is changed
+    long long last_ns;   // when it last ran
+    long long late_ns;   // how far past its deadline it last ran
+    unsigned long runs;
+    unsigned long missed; // deadlines skipped because we woke up too late for them
+    struct Histogram *latency; // how long each run took, NULL when not measured
+    struct Histogram *jitter; // late_ns of each run, NULL when not measured
+} Collector;
+
+// A file descriptor polled alongside the timer, owned by the caller
+typedef struct {
+    int fd;
+    watch_fn fn;
+    void *ctx;
+} Watch;
+
+// Runs every collector off one absolute-deadline timerfd inside a single epoll loop
+typedef struct {
+    int tfd;
+    int epfd;
+    long long armed_ns;
+    long long start_ns;
+    Collector col[SCHED_MAX_COLLECTORS];
+    int ncol;
+} Scheduler;
+
+long long now_ns();
+long long wall_ns();
+int sched_init(Scheduler *s);
+Collector *sched_add(Scheduler *s, const char *name, long period_us, collector_fn fn, void *ctx);
+void sched_set_period(Scheduler *s, Collector *c, long long period_ns);
+int sched_watch(Scheduler *s, Watch *w, uint32_t events);
+int sched_unwatch(Scheduler *s, Watch *w);
+int sched_run_once(Scheduler *s);
+void sched_close(Scheduler *s);
+
+#endif
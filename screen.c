@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "screen.h"
+
+#define MOVE_MAX 16 // "\033[rrrrr;ccccH"
+#define GAP_REPRINT 4 // reprinting up to this many unchanged cells is cheaper than a cursor move
+#define COLOR_MAX 5 // "\033[3cm"
+
+// front starts out blank, so the terminal must have just been cleared
+int screen_init(Screen *s, int fd, int rows, int cols) {
+    memset(s, 0, sizeof(*s));
+    s->fd = fd;
+    s->rows = rows;
+    s->cols = cols;
+    s->front = malloc(rows * cols * sizeof(uint32_t));
+    s->back = malloc(rows * cols * sizeof(uint32_t));
+    s->out_cap = (size_t)rows * cols * (4 + MOVE_MAX + COLOR_MAX) + MOVE_MAX + COLOR_MAX; //worst case: every cell changed and needs its own move and color
+    s->out = malloc(s->out_cap);
+    if (s->front == NULL || s->back == NULL || s->out == NULL) {
+        perror("malloc error, unable to allocate the screen buffers");
+        screen_free(s);
+        return -1;
+    }
+    for (int i = 0; i < rows * cols; i++) {
+        s->front[i] = s->back[i] = ' ';
+    }
+    return 0;
+}
+
+void screen_free(Screen *s) {
+    free(s->front);
+    free(s->back);
+    free(s->out);
+    s->front = s->back = NULL;
+    s->out = NULL;
+}
+
+// row and col are 1-based like the terminal's, anything outside the buffer is clipped
+void screen_set(Screen *s, int row, int col, uint32_t ch) {
+    if (row < 1 || row > s->rows || col < 1 || col > s->cols) {
+        return;
+    }
+    s->back[(row - 1) * s->cols + (col - 1)] = ch;
+}
+
+void screen_fill(Screen *s, int row, int col, int len, uint32_t ch) {
+    for (int i = 0; i < len; i++) {
+        screen_set(s, row, col + i, ch);
+    }
+}
+
+// Writes UTF-8 text starting at (row, col), returns the number of cells used
+int screen_put(Screen *s, int row, int col, const char *text) {
+    const unsigned char *p = (const unsigned char *)text;
+    int n = 0;
+    while (*p) {
+        uint32_t ch = *p++;
+        int extra = 0;
+        if (ch >= 0xF0) {
+            ch &= 0x07;
+            extra = 3;
+        }
+        else if (ch >= 0xE0) {
+            ch &= 0x0F;
+            extra = 2;
+        }
+        else if (ch >= 0xC0) {
+            ch &= 0x1F;
+            extra = 1;
+        }
+        for (; extra > 0 && (*p & 0xC0) == 0x80; extra--) {
+            ch = (ch << 6) | (*p++ & 0x3F);
+        }
+        screen_set(s, row, col + n, ch);
+        n++;
+    }
+    return n;
+}
+
+int screen_printf(Screen *s, int row, int col, const char *fmt, ...) {
+    char text[512];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(text, sizeof(text), fmt, ap);
+    va_end(ap);
+    return screen_put(s, row, col, text);
+}
+
+static char *put_utf8(char *o, uint32_t ch) {
+    if (ch < 0x80) {
+        *o++ = ch;
+    }
+    else if (ch < 0x800) {
+        *o++ = 0xC0 | (ch >> 6);
+        *o++ = 0x80 | (ch & 0x3F);
+    }
+    else if (ch < 0x10000) {
+        *o++ = 0xE0 | (ch >> 12);
+        *o++ = 0x80 | ((ch >> 6) & 0x3F);
+        *o++ = 0x80 | (ch & 0x3F);
+    }
+    else {
+        *o++ = 0xF0 | (ch >> 18);
+        *o++ = 0x80 | ((ch >> 12) & 0x3F);
+        *o++ = 0x80 | ((ch >> 6) & 0x3F);
+        *o++ = 0x80 | (ch & 0x3F);
+    }
+    return o;
+}
+
+static char *put_move(char *o, int row, int col) {
+    return o + sprintf(o, "\033[%d;%dH", row, col);
+}
+
+// Writes one cell, switching the color first when it differs from the one in use
+static char *put_cell(char *o, uint32_t cell, uint32_t *color) {
+    uint32_t want = cell >> 24;
+    if (want != *color) {
+        o += want == 0 ? sprintf(o, "\033[0m") : sprintf(o, "\033[3%um", want);
+        *color = want;
+    }
+    return put_utf8(o, cell & SCREEN_CH_MASK);
+}
+
+// Sends the cells that differ from the last frame in a single write and parks the
+// cursor on cursor_row. Returns the number of bytes written
+size_t screen_flush(Screen *s, int cursor_row) {
+    char *o = s->out;
+    int cur_r = -1;
+    int cur_c = -1; //where the terminal cursor is, -1 when we don't know
+    uint32_t color = 0; //every flush starts and ends in the default color
+
+    for (int r = 0; r < s->rows; r++) {
+        uint32_t *back = s->back + r * s->cols;
+        uint32_t *front = s->front + r * s->cols;
+        for (int c = 0; c < s->cols; c++) {
+            if (back[c] == front[c]) {
+                continue;
+            }
+            if (cur_r == r && c >= cur_c && c - cur_c <= GAP_REPRINT) {
+                for (int k = cur_c; k < c; k++) { //Cheaper to reprint the unchanged cells in between
+                    o = put_cell(o, back[k], &color);
+                }
+            }
+            else {
+                o = put_move(o, r + 1, c + 1);
+            }
+            o = put_cell(o, back[c], &color);
+            front[c] = back[c];
+            cur_r = r;
+            cur_c = c + 1;
+        }
+    }
+    if (color != 0) {
+        o += sprintf(o, "\033[0m");
+    }
+    if (o != s->out) {
+        o = put_move(o, cursor_row, 1); //Keep the cursor below the graphs
+    }
+
+    size_t len = o - s->out;
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(s->fd, s->out + done, len - done);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        done += n;
+    }
+    s->last_bytes = done;
+    s->total_bytes += done;
+    s->frames++;
+    return done;
+}
@@ -0,0 +1,33 @@
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCREEN_CH_MASK 0x00FFFFFFu      // a cell's code point, the top byte is its color
+#define SCREEN_COLOR(c) ((uint32_t)(c) << 24) // c is an ANSI color from 1 (red) to 7 (white), 0 is the default
+
+// Off-screen cell buffer. Drawing goes to back, screen_flush diffs it against front
+// (what the terminal already shows) and sends only the changed cells in one write()
+typedef struct {
+    int rows;
+    int cols;
+    uint32_t *front;
+    uint32_t *back; //one unicode code point per cell, with its color in the top byte
+    char *out;
+    size_t out_cap;
+    int fd;
+    size_t last_bytes; //bytes written by the last flush
+    unsigned long long total_bytes;
+    unsigned long frames;
+} Screen;
+
+int screen_init(Screen *s, int fd, int rows, int cols);
+void screen_free(Screen *s);
+void screen_set(Screen *s, int row, int col, uint32_t ch);
+int screen_put(Screen *s, int row, int col, const char *text);
+int screen_printf(Screen *s, int row, int col, const char *fmt, ...) __attribute__((format(printf, 4, 5)));
+void screen_fill(Screen *s, int row, int col, int len, uint32_t ch);
+size_t screen_flush(Screen *s, int cursor_row);
+
+#endif
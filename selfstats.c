@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "selfstats.h"
+
+void hist_init(Histogram *h, const char *name, const char *unit, double scale) {
+    memset(h, 0, sizeof(*h));
+    h->name = name;
+    h->unit = unit;
+    h->scale = scale;
+}
+
+void hist_add(Histogram *h, unsigned long long v) {
+    int i = v == 0 ? 0 : 64 - __builtin_clzll(v);
+    if (i >= HIST_BUCKETS) {
+        i = HIST_BUCKETS - 1;
+    }
+    h->bucket[i]++;
+    h->count++;
+    h->sum += v;
+    if (v > h->max) {
+        h->max = v;
+    }
+}
+
+// Upper edge of the bucket holding the p-th fraction of the values, so it errs high by at most 2x
+unsigned long long hist_percentile(const Histogram *h, double p) {
+    unsigned long long target = (unsigned long long)(p * h->count + 0.5);
+    unsigned long long seen = 0;
+    if (target == 0) {
+        target = 1;
+    }
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->bucket[i];
+        if (seen >= target) {
+            unsigned long long edge = i == 0 ? 0 : (1ULL << i) - 1;
+            return edge < h->max ? edge : h->max;
+        }
+    }
+    return h->max;
+}
+
+void selfstats_init(SelfStats *s) {
+    memset(s, 0, sizeof(*s));
+    hist_init(&s->render, "render", "us", 1e-3);
+    hist_init(&s->cpu, "monitor cpu", "%", 1e-2);
+    hist_init(&s->rss, "monitor rss", "MB", 1.0 / 1024);
+    s->statm.fd = -1;
+    if (proc_open(&s->statm, "/proc/self/statm") == -1) {
+        perror("unable to open /proc/self/statm");
+    }
+}
+
+// Gives every collector of the scheduler a latency and a jitter histogram
+void selfstats_attach(SelfStats *s, Scheduler *sched) {
+    s->sched = sched;
+    for (int i = 0; i < sched->ncol; i++) {
+        Collector *c = &sched->col[i];
+        hist_init(&s->latency[i], c->name, "us", 1e-3);
+        hist_init(&s->jitter[i], c->name, "us", 1e-3);
+        c->latency = &s->latency[i];
+        c->jitter = &s->jitter[i];
+    }
+}
+
+// Collector for the monitor's own CPU use since the last run and its current RSS
+void selfstats_usage(void *ctx, long long ts_ns) {
+    SelfStats *s = ctx;
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        long long cpu_ns = (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000LL
+                         + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000LL;
+        if (s->prev_wall_ns > 0 && ts_ns > s->prev_wall_ns) {
+            hist_add(&s->cpu, (cpu_ns - s->prev_cpu_ns) * 10000 / (ts_ns - s->prev_wall_ns));
+        }
+        s->prev_cpu_ns = cpu_ns;
+        s->prev_wall_ns = ts_ns;
+    }
+    if (s->statm.fd != -1 && proc_read(&s->statm) > 0) {
+        const char *p = s->statm.buf;
+        scan_u64(&p); //size
+        hist_add(&s->rss, scan_u64(&p) * (sysconf(_SC_PAGESIZE) / 1024));
+    }
+}
+
+static int hist_print(FILE *f, const char *what, const Histogram *h) {
+    if (h->count == 0) {
+        return 0;
+    }
+    char label[64];
+    snprintf(label, sizeof(label), "%s%s%s (%s)", what, *what ? " " : "", h->name, h->unit);
+    fprintf(f, "%-28s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", label, h->count,
+            (double)h->sum / h->count * h->scale,
+            hist_percentile(h, 0.5) * h->scale, hist_percentile(h, 0.9) * h->scale,
+            hist_percentile(h, 0.99) * h->scale, h->max * h->scale);
+    return 1;
+}
+
+// Prints the summary table, returns how many lines it took
+int selfstats_print(SelfStats *s, FILE *f) {
+    int lines = 1;
+    fprintf(f, "%-28s %10s %10s %10s %10s %10s %10s\n", "Self stats", "count", "avg", "p50", "p90", "p99", "max");
+    if (s->sched != NULL) {
+        for (int i = 0; i < s->sched->ncol; i++) {
+            lines += hist_print(f, "parse", &s->latency[i]);
+        }
+        for (int i = 0; i < s->sched->ncol; i++) {
+            lines += hist_print(f, "jitter", &s->jitter[i]);
+        }
+    }
+    lines += hist_print(f, "", &s->render);
+    lines += hist_print(f, "", &s->cpu);
+    lines += hist_print(f, "", &s->rss);
+    if (s->sched != NULL) {
+        for (int i = 0; i < s->sched->ncol; i++) {
+            fprintf(f, "missed deadlines %-11s %10lu\n", s->sched->col[i].name, s->sched->col[i].missed);
+            lines++;
+        }
+    }
+    fflush(f);
+    return lines;
+}
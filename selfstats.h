@@ -0,0 +1,43 @@
+#ifndef SELFSTATS_H
+#define SELFSTATS_H
+
+#include <stdio.h>
+#include "sampler.h"
+#include "sched.h"
+
+#define HIST_BUCKETS 40 // bucket i counts values in [2^(i-1), 2^i), bucket 0 counts zeros
+
+// Fixed-bucket log2 histogram, adding a value is O(1) and never allocates
+typedef struct Histogram {
+    const char *name;
+    const char *unit;
+    double scale; //raw value * scale is printed in unit
+    unsigned long long count;
+    unsigned long long sum;
+    unsigned long long max;
+    unsigned long long bucket[HIST_BUCKETS];
+} Histogram;
+
+// How much the monitor costs and how late its samples are, for --self-stats
+typedef struct {
+    Histogram latency[SCHED_MAX_COLLECTORS]; //per collector, how long its parse took
+    Histogram jitter[SCHED_MAX_COLLECTORS]; //per collector, how late after its deadline it ran
+    Histogram render; //per frame or headless record
+    Histogram cpu; //the monitor's own CPU use, in hundredths of a percent
+    Histogram rss; //the monitor's resident memory, in kB
+    Scheduler *sched;
+    ProcFile statm;
+    long long prev_cpu_ns;
+    long long prev_wall_ns;
+} SelfStats;
+
+void hist_init(Histogram *h, const char *name, const char *unit, double scale);
+void hist_add(Histogram *h, unsigned long long v);
+unsigned long long hist_percentile(const Histogram *h, double p);
+
+void selfstats_init(SelfStats *s);
+void selfstats_attach(SelfStats *s, Scheduler *sched);
+void selfstats_usage(void *ctx, long long ts_ns);
+int selfstats_print(SelfStats *s, FILE *f);
+
+#endif
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shm.h"
+
+// Bytes of the sample that are actually copied, the head and the cores that are used
+static size_t sample_bytes(uint32_t ncores) {
+    return offsetof(Sample, core) + ncores * sizeof(float);
+}
+
+// "load" and "/load" both name /dev/shm/load
+static int shm_name(Shm *m, const char *name) {
+    if (name[0] == '/') {
+        name++;
+    }
+    if (name[0] == '\0' || strchr(name, '/') != NULL || strlen(name) + 2 > sizeof(m->name)) {
+        fprintf(stderr, "bad shared memory name \"%s\", expected a name without '/'\n", name);
+        return -1;
+    }
+    snprintf(m->name, sizeof(m->name), "/%s", name);
+    return 0;
+}
+
+// Creates the segment, or takes over one left behind by a monitor that is gone. A monitor
+// that is still publishing under the same name is left alone
+int shm_create(Shm *m, const char *name, int ncores) {
+    memset(m, 0, sizeof(*m));
+    m->fd = -1;
+    if (shm_name(m, name) == -1) {
+        return -1;
+    }
+    m->fd = shm_open(m->name, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m->fd == -1) {
+        perror("shm_open error");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(m->fd, &st) == 0 && st.st_size >= (off_t)sizeof(ShmSegment)) {
+        ShmSegment old;
+        if (pread(m->fd, &old, offsetof(ShmSegment, seq), 0) == offsetof(ShmSegment, seq)
+            && memcmp(old.magic, SHM_MAGIC, 8) == 0 && old.pid != getpid() && (kill(old.pid, 0) == 0 || errno == EPERM)) {
+            fprintf(stderr, "%s is already published by pid %d\n", m->name, old.pid);
+            close(m->fd);
+            m->fd = -1;
+            return -1;
+        }
+    }
+    if (ftruncate(m->fd, sizeof(ShmSegment)) == -1) {
+        perror("ftruncate error");
+        shm_close(m);
+        return -1;
+    }
+    m->seg = mmap(NULL, sizeof(ShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, m->fd, 0);
+    if (m->seg == MAP_FAILED) {
+        perror("mmap error");
+        m->seg = NULL;
+        shm_close(m);
+        return -1;
+    }
+    m->writer = 1;
+    memset(m->seg, 0, sizeof(ShmSegment)); //seq 0: nothing published yet
+    m->seg->version = SHM_VERSION;
+    m->seg->size = sizeof(ShmSegment);
+    m->seg->ncores = ncores < MAX_CORES ? ncores : MAX_CORES;
+    m->seg->pid = getpid();
+    uint64_t magic;
+    memcpy(&magic, SHM_MAGIC, sizeof(magic));
+    __atomic_store_n((uint64_t *)m->seg->magic, magic, __ATOMIC_RELEASE); //Last, readers check it first
+    return 0;
+}
+
+// Makes s the latest sample. Never blocks or makes a syscall, readers retry a copy that
+// overlapped this one
+void shm_publish(Shm *m, const Sample *s, long long period_ns) {
+    ShmSegment *seg = m->seg;
+    uint64_t seq = seg->seq;
+    __atomic_store_n(&seg->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE); //The odd seq is visible before any of the new values
+    memcpy(&seg->sample, s, sample_bytes(seg->ncores));
+    seg->sample.ncores = seg->ncores;
+    seg->published++;
+    seg->period_ns = period_ns;
+    __atomic_store_n(&seg->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+// Maps a published segment read-only
+int shm_attach(Shm *m, const char *name) {
+    memset(m, 0, sizeof(*m));
+    m->fd = -1;
+    if (shm_name(m, name) == -1) {
+        return -1;
+    }
+    m->fd = shm_open(m->name, O_RDONLY | O_CLOEXEC, 0);
+    if (m->fd == -1) {
+        fprintf(stderr, "unable to open %s: %s, is a monitor running with --shm?\n", m->name, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(m->fd, &st) == -1 || st.st_size < (off_t)sizeof(ShmSegment)) {
+        fprintf(stderr, "%s is not a sysmon segment\n", m->name);
+        shm_close(m);
+        return -1;
+    }
+    m->seg = mmap(NULL, sizeof(ShmSegment), PROT_READ, MAP_SHARED, m->fd, 0);
+    if (m->seg == MAP_FAILED) {
+        perror("mmap error");
+        m->seg = NULL;
+        shm_close(m);
+        return -1;
+    }
+    if (memcmp(m->seg->magic, SHM_MAGIC, 8) != 0 || m->seg->version != SHM_VERSION
+        || m->seg->size != sizeof(ShmSegment) || m->seg->ncores > MAX_CORES) {
+        fprintf(stderr, "%s is not a sysmon segment of this version\n", m->name);
+        shm_close(m);
+        return -1;
+    }
+    return 0;
+}
+
+// Copies the latest sample into s without a syscall or a lock. Returns -1 with errno ENODATA
+// before the first sample, and EAGAIN when every attempt overlapped an update. That is usually
+// a writer preempted in the middle of shm_publish, so callers should wait a little and try
+// again. Only a writer whose pid is gone will never finish the update
+int shm_snapshot(const Shm *m, Sample *s, uint64_t *seq, long long *period_ns) {
+    const ShmSegment *seg = m->seg;
+    for (int attempt = 0; attempt < SHM_RETRIES; attempt++) {
+        uint64_t before = __atomic_load_n(&seg->seq, __ATOMIC_ACQUIRE);
+        if (before == 0) {
+            errno = ENODATA;
+            return -1;
+        }
+        if (before & 1) {
+            continue; //Being written
+        }
+        memcpy(s, &seg->sample, sample_bytes(seg->ncores));
+        long long period = seg->period_ns;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE); //The copy is done before seq is read again
+        if (__atomic_load_n(&seg->seq, __ATOMIC_RELAXED) == before) {
+            s->ncores = seg->ncores;
+            if (seq != NULL) {
+                *seq = before;
+            }
+            if (period_ns != NULL) {
+                *period_ns = period;
+            }
+            return 0;
+        }
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+// The writer also removes the name, readers that still have it mapped keep the last sample
+void shm_close(Shm *m) {
+    if (m->seg != NULL) {
+        munmap(m->seg, sizeof(ShmSegment));
+        m->seg = NULL;
+    }
+    if (m->fd != -1) {
+        close(m->fd);
+        m->fd = -1;
+    }
+    if (m->writer) {
+        shm_unlink(m->name);
+        m->writer = 0;
+    }
+}
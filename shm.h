@@ -0,0 +1,44 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <stdint.h>
+#include <limits.h>
+#include "sample.h"
+
+#define SHM_MAGIC "SYSMONM1"
+#define SHM_VERSION 1
+#define SHM_RETRIES 1000 // snapshot attempts before EAGAIN, while the writer is in the middle of an update
+
+// The segment --shm=NAME publishes to /dev/shm/NAME. Its layout is fixed: a 64-byte header,
+// then a Sample whose core array is always MAX_CORES long, only the first ncores are set.
+// seq is a seqlock: odd while the monitor writes, even once the sample is consistent again,
+// and 0 until the first sample. Everything after seq is only valid when seq was read
+// even and unchanged around the copy
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t size;        // bytes of the whole segment
+    uint32_t ncores;
+    int32_t pid;          // the publishing monitor
+    uint64_t seq;
+    uint64_t published;   // samples ever published
+    int64_t period_ns;    // interval the sample was taken at
+    char pad[16];
+    Sample sample;
+} ShmSegment;
+
+// One end of a segment. The monitor creates and writes it, any number of readers attach
+typedef struct {
+    int fd;
+    ShmSegment *seg;
+    int writer;
+    char name[NAME_MAX];
+} Shm;
+
+int shm_create(Shm *m, const char *name, int ncores);
+void shm_publish(Shm *m, const Sample *s, long long period_ns);
+int shm_attach(Shm *m, const char *name);
+int shm_snapshot(const Shm *m, Sample *s, uint64_t *seq, long long *period_ns);
+void shm_close(Shm *m);
+
+#endif
@@ -0,0 +1,103 @@
+// Prints what a monitor running with --shm=NAME last published, in the formats of --format.
+// The reader side of shm.c for tools that would rather run a command than map the segment
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include "shm.h"
+#include "output.h"
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s NAME [--format=csv|jsonl] [--every=MS] [--count=N]\n"
+            "prints the latest sample of a monitor started with --shm=NAME, once, or every MS\n"
+            "milliseconds until N samples were printed (0 for no end) or the monitor exits\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    const char *name = NULL;
+    int format = FORMAT_CSV;
+    long every_ms = 0;
+    long count = 1;
+    int count_given = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--format=", 9) == 0) {
+            format = output_format(argv[i] + 9);
+            if (format == -1 || format == FORMAT_BIN) {
+                usage(argv[0]);
+            }
+        }
+        else if (strncmp(argv[i], "--every=", 8) == 0) {
+            every_ms = atol(argv[i] + 8);
+        }
+        else if (strncmp(argv[i], "--count=", 8) == 0) {
+            count = atol(argv[i] + 8);
+            count_given = 1;
+        }
+        else if (argv[i][0] != '-' && name == NULL) {
+            name = argv[i];
+        }
+        else {
+            usage(argv[0]);
+        }
+    }
+    if (name == NULL || every_ms < 0 || count < 0) {
+        usage(argv[0]);
+    }
+    if (every_ms > 0 && !count_given) {
+        count = 0; //--every alone prints until stopped
+    }
+
+    Shm shm;
+    if (shm_attach(&shm, name) == -1) {
+        return 1;
+    }
+    int gone = kill(shm.seg->pid, 0) == -1 && errno == ESRCH;
+    if (gone) {
+        fprintf(stderr, "the monitor that published %s (pid %d) is gone, these values are its last\n", shm.name, shm.seg->pid);
+    }
+    Output out;
+    if (output_open(&out, NULL, format, shm.seg->ncores, 1, 0) == -1) {
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    static Sample s; //Too large for a comfortable stack frame with MAX_CORES cores
+    uint64_t last = 0;
+    long printed = 0;
+    int status = 0;
+    while (count == 0 || printed < count) {
+        uint64_t seq;
+        if (shm_snapshot(&shm, &s, &seq, NULL) == -1) {
+            if (errno == EAGAIN) {
+                if (gone || (kill(shm.seg->pid, 0) == -1 && errno == ESRCH)) {
+                    fprintf(stderr, "the monitor exited in the middle of an update of %s\n", shm.name);
+                    return 1;
+                }
+                usleep(1000); //Most likely preempted while publishing, it finishes once it runs again
+                continue;
+            }
+        }
+        else if (seq != last) { //Only samples that were not printed yet
+            last = seq;
+            if (output_write(&out, &s) == -1) {
+                break;
+            }
+            printed++;
+            continue;
+        }
+        if (gone || (kill(shm.seg->pid, 0) == -1 && errno == ESRCH)) { //No further sample will come
+            if (!gone) {
+                fprintf(stderr, "the monitor that published %s (pid %d) exited\n", shm.name, shm.seg->pid);
+            }
+            status = count > 0; //Fewer samples than --count asked for
+            break;
+        }
+        usleep(every_ms > 0 ? every_ms * 1000 : 10000); //Without --every, only until the next sample
+    }
+    output_close(&out);
+    shm_close(&shm);
+    return status;
+}
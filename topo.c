@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include "topo.h"
+
+// Reads a small sysfs file into buf, -1 when it is missing
+static int read_small(const char *rel, char *buf, size_t len) {
+    char path[PATH_MAX];
+    int fd = open(proc_path(rel, path), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    ssize_t n = read(fd, buf, len - 1);
+    close(fd);
+    if (n <= 0) {
+        return -1;
+    }
+    buf[n] = '\0';
+    return 0;
+}
+
+// First number in a sysfs file of cpu, fallback when it is missing
+static int read_cpu_value(int cpu, const char *file, int fallback) {
+    char rel[96], buf[32];
+    snprintf(rel, sizeof(rel), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, file);
+    if (read_small(rel, buf, sizeof(buf)) == -1) {
+        return fallback;
+    }
+    const char *p = buf;
+    return (int)scan_u64(&p);
+}
+
+// Position of cpu among its SMT siblings: how many of them have a lower id
+static int read_thread(int cpu) {
+    char rel[96], buf[256];
+    snprintf(rel, sizeof(rel), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    if (read_small(rel, buf, sizeof(buf)) == -1) {
+        return 0;
+    }
+    char mask[cpu + 1];
+    memset(mask, 0, sizeof(mask));
+    return cpulist_mark(buf, mask, cpu); //Only ids below cpu are counted
+}
+
+static int by_id(const void *a, const void *b) {
+    return ((const TopoNode *)a)->id - ((const TopoNode *)b)->id;
+}
+
+// One group per nodeN directory, memory-only nodes included. 0 when there is no NUMA information
+static int read_nodes(Topology *t) {
+    char path[PATH_MAX];
+    DIR *d = opendir(proc_path("/sys/devices/system/node", path));
+    if (d == NULL) {
+        return 0;
+    }
+    struct dirent *de;
+    int cap = 0;
+    while ((de = readdir(d)) != NULL) {
+        if (strncmp(de->d_name, "node", 4) != 0 || de->d_name[4] < '0' || de->d_name[4] > '9') {
+            continue;
+        }
+        if (t->nnodes == cap) {
+            cap = cap > 0 ? cap * 2 : 8;
+            TopoNode *bigger = realloc(t->node, cap * sizeof(TopoNode));
+            if (bigger == NULL) {
+                perror("realloc error, unable to grow the node table");
+                closedir(d);
+                return -1;
+            }
+            t->node = bigger;
+        }
+        TopoNode *n = &t->node[t->nnodes++];
+        memset(n, 0, sizeof(*n));
+        n->id = atoi(de->d_name + 4);
+        n->meminfo = (ProcFile)PROC_FILE_INIT;
+    }
+    closedir(d);
+    if (t->nnodes == 0) {
+        return 0;
+    }
+    qsort(t->node, t->nnodes, sizeof(TopoNode), by_id);
+    char *mask = malloc(t->ncpus);
+    if (mask == NULL) {
+        perror("malloc error, unable to allocate the node cpu mask");
+        return -1;
+    }
+    for (int g = 0; g < t->nnodes; g++) {
+        char rel[64], buf[4096];
+        snprintf(rel, sizeof(rel), "/sys/devices/system/node/node%d/cpulist", t->node[g].id);
+        memset(mask, 0, t->ncpus);
+        if (read_small(rel, buf, sizeof(buf)) == 0) {
+            cpulist_mark(buf, mask, t->ncpus);
+        }
+        for (int i = 0; i < t->ncpus; i++) {
+            if (mask[i]) {
+                t->cpu[i].group = g;
+            }
+        }
+        snprintf(rel, sizeof(rel), "/sys/devices/system/node/node%d/meminfo", t->node[g].id);
+        proc_open(&t->node[g].meminfo, proc_path(rel, path)); //fd stays -1 when it cannot be read
+    }
+    free(mask);
+    t->numa = 1;
+    return t->nnodes;
+}
+
+// Without NUMA information every socket is a group
+static int group_by_package(Topology *t) {
+    for (int i = 0; i < t->ncpus; i++) {
+        if (!t->cpu[i].online) {
+            continue;
+        }
+        int g = 0;
+        while (g < t->nnodes && t->node[g].id != t->cpu[i].package) {
+            g++;
+        }
+        if (g == t->nnodes) {
+            TopoNode *bigger = realloc(t->node, (t->nnodes + 1) * sizeof(TopoNode));
+            if (bigger == NULL) {
+                perror("realloc error, unable to grow the node table");
+                return -1;
+            }
+            t->node = bigger;
+            memset(&t->node[g], 0, sizeof(TopoNode));
+            t->node[g].id = t->cpu[i].package;
+            t->node[g].meminfo = (ProcFile)PROC_FILE_INIT;
+            t->nnodes++;
+        }
+    }
+    qsort(t->node, t->nnodes, sizeof(TopoNode), by_id);
+    for (int i = 0; i < t->ncpus; i++) {
+        for (int g = 0; g < t->nnodes; g++) {
+            if (t->node[g].id == t->cpu[i].package) {
+                t->cpu[i].group = g;
+            }
+        }
+    }
+    return 0;
+}
+
+static const Topology *sorting; //qsort has no context argument
+
+static int by_position(const void *a, const void *b) {
+    const TopoCpu *x = &sorting->cpu[*(const int *)a], *y = &sorting->cpu[*(const int *)b];
+    if (x->group != y->group) {
+        return x->group - y->group;
+    }
+    if (x->package != y->package) {
+        return x->package - y->package;
+    }
+    if (x->core != y->core) {
+        return x->core - y->core;
+    }
+    if (x->thread != y->thread) {
+        return x->thread - y->thread;
+    }
+    return *(const int *)a - *(const int *)b;
+}
+
+int topo_init(Topology *t) {
+    memset(t, 0, sizeof(*t));
+    t->ncpus = cpu_count();
+    t->cpu = calloc(t->ncpus, sizeof(TopoCpu));
+    t->order = malloc(t->ncpus * sizeof(int));
+    if (t->cpu == NULL || t->order == NULL) {
+        perror("malloc error, unable to allocate the topology");
+        return -1;
+    }
+    char buf[4096];
+    char online[t->ncpus];
+    memset(online, 0, t->ncpus);
+    if (read_small("/sys/devices/system/cpu/online", buf, sizeof(buf)) == -1 || cpulist_mark(buf, online, t->ncpus) == 0) {
+        memset(online, 1, t->ncpus); //No list, e.g. an old --proc-root copy: every possible cpu then
+    }
+    for (int i = 0; i < t->ncpus; i++) {
+        t->cpu[i].online = online[i];
+    }
+    int packages[t->ncpus];
+    for (int i = 0; i < t->ncpus; i++) {
+        TopoCpu *c = &t->cpu[i];
+        if (!c->online) {
+            continue;
+        }
+        c->package = read_cpu_value(i, "physical_package_id", 0);
+        c->core = read_cpu_value(i, "core_id", i);
+        c->thread = read_thread(i);
+        if (c->thread + 1 > t->smt) {
+            t->smt = c->thread + 1;
+        }
+        int known = 0;
+        while (known < t->npackages && packages[known] != c->package) {
+            known++;
+        }
+        if (known == t->npackages) {
+            packages[t->npackages++] = c->package;
+        }
+    }
+    if (read_nodes(t) == -1 || (t->nnodes == 0 && group_by_package(t) == -1)) {
+        return -1;
+    }
+    for (int i = 0; i < t->ncpus; i++) {
+        if (t->cpu[i].online) {
+            t->order[t->nonline++] = i;
+        }
+    }
+    sorting = t;
+    qsort(t->order, t->nonline, sizeof(int), by_position);
+    for (int k = t->nonline - 1; k >= 0; k--) {
+        TopoNode *n = &t->node[t->cpu[t->order[k]].group];
+        n->first = k;
+        n->n++;
+        n->package = t->cpu[t->order[k]].package;
+    }
+    for (int g = 0; g < t->nnodes; g++) {
+        if (t->node[g].n == 0) {
+            t->node[g].first = t->nonline;
+            t->node[g].package = -1;
+        }
+    }
+    return topo_read_memory(t);
+}
+
+// Re-reads the meminfo of every node, its lines look like "Node 0 MemTotal:  65843720 kB"
+int topo_read_memory(Topology *t) {
+    for (int g = 0; g < t->nnodes; g++) {
+        TopoNode *n = &t->node[g];
+        if (n->meminfo.fd == -1 || proc_read(&n->meminfo) <= 0) {
+            continue;
+        }
+        const char *p = n->meminfo.buf;
+        const char *end = p + n->meminfo.len;
+        int found = 0;
+        while (p < end && found < 3) {
+            const char *nl = memchr(p, '\n', end - p);
+            if (nl == NULL) {
+                nl = end;
+            }
+            const char *key = memchr(p, ' ', nl - p); //After "Node"
+            key = key != NULL ? memchr(key + 1, ' ', nl - key - 1) : NULL; //After the node id
+            if (key != NULL) {
+                key++;
+                const char *q = strchr(key, ':');
+                if (q != NULL && q < nl) {
+                    q++;
+                    if (strncmp(key, "MemTotal:", 9) == 0) {
+                        n->mem_total = scan_u64(&q);
+                        found++;
+                    }
+                    else if (strncmp(key, "MemFree:", 8) == 0) {
+                        n->mem_free = scan_u64(&q);
+                        found++;
+                    }
+                    else if (strncmp(key, "FilePages:", 10) == 0) {
+                        n->mem_file = scan_u64(&q);
+                        found++;
+                    }
+                }
+            }
+            p = nl + 1;
+        }
+        unsigned long long held = n->mem_free + n->mem_file;
+        n->mem_used = (n->mem_total > held ? n->mem_total - held : 0) / KB_PER_GB; //Page cache can be reclaimed, as in get_ram_y
+    }
+    return 0;
+}
+
+void topo_collect(void *ctx, long long ts_ns) {
+    topo_read_memory(ctx);
+}
+
+// Averages the utilization of each node's cpus, core is indexed by cpu id
+void topo_cpu(Topology *t, const float *core, int ncores) {
+    for (int g = 0; g < t->nnodes; g++) {
+        TopoNode *n = &t->node[g];
+        float sum = 0;
+        int counted = 0;
+        for (int k = n->first; k < n->first + n->n; k++) {
+            if (t->order[k] < ncores) {
+                sum += core[t->order[k]];
+                counted++;
+            }
+        }
+        n->cpu = counted > 0 ? sum / counted : 0;
+    }
+}
+
+void topo_free(Topology *t) {
+    for (int g = 0; g < t->nnodes; g++) {
+        proc_close(&t->node[g].meminfo);
+    }
+    free(t->node);
+    free(t->cpu);
+    free(t->order);
+    t->node = NULL;
+    t->cpu = NULL;
+    t->order = NULL;
+    t->nnodes = t->nonline = 0;
+}
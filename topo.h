@@ -0,0 +1,46 @@
+#ifndef TOPO_H
+#define TOPO_H
+
+#include "sampler.h"
+
+// Where one logical cpu sits, from /sys/devices/system/cpu/cpuN/topology
+typedef struct {
+    int online;
+    int package;   // physical_package_id, the socket
+    int core;      // core_id within the package
+    int thread;    // 0 for the first of its SMT siblings, 1 for the next one...
+    int group;     // index into Topology.node
+} TopoCpu;
+
+// A NUMA node, or a socket on hosts without /sys/devices/system/node
+typedef struct {
+    int id;                 // N of nodeN, or the package id
+    int first, n;           // its online cpus are order[first] to order[first + n - 1]
+    int package;            // socket of its first cpu, -1 for a node with memory only
+    ProcFile meminfo;       // nodeN/meminfo, fd -1 when grouped by socket
+    unsigned long long mem_total, mem_free, mem_file; // kB
+    float mem_used;         // GB, without what is free or page cache
+    float cpu;              // average utilization of its online cpus
+} TopoNode;
+
+// Sockets, cores, SMT siblings and NUMA nodes of this host, read once from sysfs. Only the
+// per-node meminfo files are re-read, one pread per node
+typedef struct {
+    int ncpus;              // possible cpus, cpu has one entry per id
+    TopoCpu *cpu;
+    int *order;             // online cpus by node, socket, core and thread, so SMT siblings sit side by side
+    int nonline;
+    TopoNode *node;
+    int nnodes;
+    int numa;               // 1 when the groups are NUMA nodes, 0 when they are sockets
+    int npackages;
+    int smt;                // most threads per core
+} Topology;
+
+int topo_init(Topology *t);
+int topo_read_memory(Topology *t);
+void topo_collect(void *ctx, long long ts_ns);
+void topo_cpu(Topology *t, const float *core, int ncores);
+void topo_free(Topology *t);
+
+#endif